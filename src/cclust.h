@@ -21,30 +21,30 @@
 #include <fstream>
 #include <math.h>
 #include <cstdlib>
+#include <algorithm>
+#include <cassert>
+#include "cclust_labels.h"
+#include "cclust_coassoc.h"
+#include "cclust_relations.h"
+#include "cclust_search.h"
+#include "cclust_heuristics.h"
+#include "cclust_fpt.h"
+#include "cclust_reductions.h"
+#include "cclust_subset_dp.h"
+#include "cclust_io.h"
 
 using namespace std;
 
-enum relation{
-  REL_PRED_COED,    // predominantly co-clusteringed ( >2/3 co )
-  REL_PRED_ANTIED,  // predominantly anti-clusteringed ( <1/3 co )
-  REL_DIRTY,        // dirty (1/3 <= co <= 2/3)
-  REL_UNKNOWN
+enum search_method{
+  SEARCH_BRUTE_FORCE,       // enumerate all clusterings of the unclustered elements
+  SEARCH_BRANCH_AND_BOUND,  // skip subtrees that cannot beat the best clustering found
+  SEARCH_AVERAGE_PARAMETERIZED  // resolve conflict triples within a budget of the average distance
 };
 
 // clustering<T> is an alias for map<T,uint>
 template <typename T>
 class clustering: public map<T,uint>{};
 
-// for each item 'item' there are special properties over all given clusterings
-template <typename T>
-class iteminfo {
-  public:
-  set<T> pred_coed_with;  // the items that 'item' is predominantly co-clusteringed with
-  set<T> pred_antied_with;// the items that 'item' is predominantly anti-clusteringed with
-  set<T> dirty_with;      // the items that form a dirty pair with 'item'
-  bool accounted_for;
-};
-
 
 // ************************************************************************
 // ************************** function definitions ************************
@@ -123,39 +123,345 @@ inline set<T> get_unclustered_elements(const clustering<T>& C){
   return result;
 }
 
+// ************************************************************************
+// *********************** dense representation ***************************
+// ************************************************************************
+
+// give an id to each element of the first clustering (in the order of names)
+template <typename T>
+element_dictionary<T> make_element_dictionary(const vector<clustering<T> >& clusterings){
+  element_dictionary<T> elements;
+  if(clusterings.size())
+    for(typename clustering<T>::const_iterator i = clusterings.begin()->begin();
+        i != clusterings.begin()->end(); i++)
+      elements.insert(i->first);
+  return elements;
+}
+
+// translate a clustering into a label_clustering over the ids in 'elements'
+// note that an empty clustering stays empty, that is, 'new'
+template <typename T>
+label_clustering to_label_clustering(const clustering<T>& C, const element_dictionary<T>& elements){
+  label_clustering result;
+  if(!C.empty()){
+    element_id id;
+    result = label_clustering(elements.size());
+    for(typename clustering<T>::const_iterator i = C.begin(); i != C.end(); i++)
+      if((id = elements.find(i->first)) != NO_ELEMENT) result[id] = i->second;
+  }
+  return result;
+}
+
+// translate a vector of clusterings into label_clusterings
+template <typename T>
+vector<label_clustering> to_label_clusterings(const vector<clustering<T> >& clusterings,
+                                              const element_dictionary<T>& elements){
+  vector<label_clustering> result;
+  result.reserve(clusterings.size());
+  for(typename vector<clustering<T> >::const_iterator C = clusterings.begin();
+      C != clusterings.end(); C++)
+    result.push_back(to_label_clustering(*C, elements));
+  return result;
+}
+
+// map a label_clustering back to the names of its elements
+template <typename T>
+clustering<T> to_clustering(const label_clustering& C, const element_dictionary<T>& elements){
+  clustering<T> result;
+  for(element_id i = 0; i < C.size(); i++)
+    result.insert(result.end(), pair<T,uint>(elements[i], C[i]));
+  return result;
+}
+
+// the number of unordered pairs in a set of x elements
+inline uint64_t num_pairs(const uint64_t x){
+  return x ? (x * (x - 1)) >> 1 : 0;
+}
+
+// return a copy of C whose labels are 0...k-1 (in order of the old labels) and set k
+// C is returned unchanged if its labels are already small enough to count them directly
+inline const label_clustering& compact_labels(const label_clustering& C, label_clustering& buffer, uint32_t& k){
+  k = 0;
+  for(label_clustering::const_iterator i = C.begin(); i != C.end(); i++)
+    if(*i >= k) k = *i + 1;
+  if(k <= 2 * C.size() + 1) return C;
+  // the labels are too sparse, renumber them
+  map<uint32_t, uint32_t> new_label;
+  for(label_clustering::const_iterator i = C.begin(); i != C.end(); i++)
+    new_label.insert(pair<uint32_t,uint32_t>(*i, 0));
+  k = 0;
+  for(map<uint32_t, uint32_t>::iterator i = new_label.begin(); i != new_label.end(); i++)
+    i->second = k++;
+  buffer = label_clustering(C.size());
+  for(element_id i = 0; i < C.size(); i++) buffer[i] = new_label[C[i]];
+  return buffer;
+}
+
+// a clustering prepared for (repeated) distance computations
+class distance_operand{
+  label_clustering buffer;    // the renumbered labels if those of C are too sparse
+public:
+  const label_clustering* labels; // the labels are 0...k-1
+  uint32_t k;
+  uint64_t coed_pairs;        // the number of pairs co-clustered
+
+  distance_operand(): labels(NULL), k(0), coed_pairs(0) {}
+  void prepare(const label_clustering& C){
+    labels = &compact_labels(C, buffer, k);
+    vector<uint32_t> sizes(k, 0);
+    for(label_clustering::const_iterator i = labels->begin(); i != labels->end(); i++) sizes[*i]++;
+    coed_pairs = 0;
+    for(vector<uint32_t>::const_iterator a = sizes.begin(); a != sizes.end(); a++) coed_pairs += num_pairs(*a);
+  }
+};
+
+// calculate the distance between two prepared clusterings
+// the number of pairs on which C1 and C2 disagree is the number of pairs co-clustered
+// in C1 plus the number of pairs co-clustered in C2 minus twice the number of pairs
+// co-clustered in both. Those numbers are read off the contingency table of C1 and C2,
+// whose entry (a,b) is the number of elements in cluster a of C1 and cluster b of C2,
+// so the distance takes O(n + k1*k2) time instead of looking at all O(n^2) pairs
+// (as usual, the unclustered elements are treated like a cluster)
+// 'table' and 'cells' are buffers that can be reused between calls
+inline uint get_distance(const distance_operand& C1, const distance_operand& C2,
+                         vector<uint32_t>& table, vector<uint64_t>& cells){
+  const label_clustering& L1 = *C1.labels;
+  const label_clustering& L2 = *C2.labels;
+  const uint n = L1.size();
+  const uint32_t k2 = C2.k;
+  uint64_t coed_both = 0;
+
+  // count pairs co-clustered in both
+  if((uint64_t)C1.k * k2 <= 4 * (uint64_t)n + 1024){
+    // the table is small enough to be filled directly
+    table.assign((size_t)C1.k * k2, 0);
+    for(element_id i = 0; i < n; i++) table[(size_t)L1[i] * k2 + L2[i]]++;
+    for(vector<uint32_t>::const_iterator c = table.begin(); c != table.end(); c++) coed_both += num_pairs(*c);
+  } else {
+    // the table is sparse, only consider its non-empty entries
+    cells.resize(n);
+    for(element_id i = 0; i < n; i++) cells[i] = ((uint64_t)L1[i] << 32) | L2[i];
+    sort(cells.begin(), cells.end());
+    uint64_t run = 0;
+    for(element_id i = 0; i < n; i++){
+      run++;
+      if((i + 1 == n) || (cells[i + 1] != cells[i])){
+        coed_both += num_pairs(run);
+        run = 0;
+      }
+    }
+  }
+  return (uint)(C1.coed_pairs + C2.coed_pairs - 2 * coed_both);
+}
+
+// calculate the distance between two clusterings
+inline uint get_distance(const label_clustering& C1, const label_clustering& C2){
+  distance_operand op1, op2;
+  vector<uint32_t> table;
+  vector<uint64_t> cells;
+  op1.prepare(C1);
+  op2.prepare(C2);
+  return get_distance(op1, op2, table, cells);
+}
+
+// calculate the accumulated distances between a clustering and all input clusterings
+inline uint get_distance(const label_clustering& C, const weighted_clusterings& clusterings){
+  uint dist = 0;
+  for(uint i = 0; i < clusterings.size(); i++)
+    dist += get_distance(C, clusterings.clusterings[i]) * clusterings.multiplicities[i];
+  return dist;
+}
+
+// calculate the accumulated distances between a clustering and a vector of clusterings
+inline uint get_distance(const label_clustering& C, const vector<label_clustering>& clusterings){
+  uint dist = 0;
+  for(vector<label_clustering>::const_iterator j = clusterings.begin(); j != clusterings.end(); j++)
+    dist += get_distance(C, *j);
+  return dist;
+}
+
+// calculate the accumulated distances between a clustering and all clusterings
+// counted in the co-association matrix: each pair that is co-clustered in C
+// disagrees with all clusterings anti-clustering it and vice versa
+inline uint64_t get_distance(const label_clustering& C, const coassociation_matrix& coassoc){
+  uint64_t dist = 0;
+  for(element_id i = 0; i < C.size(); i++)
+    for(element_id j = i + 1; j < C.size(); j++)
+      dist += coed(i, j, C) ? coassoc.anti_count(i, j) : coassoc.count(i, j);
+  return dist;
+}
+
+// compute the distances of all pairs of distinct clusterings and accumulate them
+// (with the multiplicities) per distinct clustering, afterwards, sums[i] is the sum
+// of the distances of clusterings.clusterings[i] to all input clusterings
+// the m x m matrix is cut into tiles of clusterings whose labels fit into the cache
+// together and the tiles are distributed over num_threads threads (0 = one per core)
+// each finished tile is added to 'sums' while 'sums_mutex' is locked and, still under
+// the lock, tile_done() is called, so partial sums can be read under the same mutex
+// the progress and the cancel flag may be atomics (P = atomic<double>, B =
+// atomic<bool>) if other threads access them while the workers run
+// return false if the computation was canceled
+template <typename F, typename P = double, typename B = bool>
+bool get_distance_sums(const weighted_clusterings& clusterings,
+                       vector<uint64_t>& sums,
+                       F tile_done,
+                       mutex* sums_mutex = NULL,
+                       P* progress_pc = NULL,
+                       const B* cancel_computation = NULL,
+                       const uint num_threads = 0){
+  const uint m = clusterings.size();
+  const uint n = m ? clusterings.clusterings.begin()->size() : 0;
+  const vector<uint>& multiplicities = clusterings.multiplicities;
+  mutex own_mutex;
+  if(!sums_mutex) sums_mutex = &own_mutex;
+  {
+    lock_guard<mutex> lock(*sums_mutex);
+    sums.assign(m, 0);
+  }
+  if(m < 2) return true;
+
+  // count the cluster sizes of each clustering only once
+  vector<distance_operand> operands(m);
+  parallel_for(0, m, [&](const uint i){ operands[i].prepare(clusterings.clusterings[i]); }, num_threads);
+
+  // about 256KB of labels per tile
+  const uint tile = max(1u, min(64u, (1u << 16) / max(n, 1u)));
+  const uint num_tiles = (m + tile - 1) / tile;
+  vector<pair<uint,uint> > tiles;
+  for(uint I = 0; I < num_tiles; I++)
+    for(uint J = I; J < num_tiles; J++)
+      tiles.push_back(pair<uint,uint>(I, J));
+  uint tiles_done = 0;
+
+  parallel_for(0, tiles.size(), [&](const uint t){
+    if(cancel_computation)
+      if(*cancel_computation) return;
+    const uint i_begin = tiles[t].first * tile, i_end = min(m, i_begin + tile);
+    const uint j_begin = tiles[t].second * tile, j_end = min(m, j_begin + tile);
+    vector<uint64_t> row_sums(tile, 0), col_sums(tile, 0);
+    vector<uint32_t> table;
+    vector<uint64_t> cells;
+    uint dist;
+    for(uint i = i_begin; i < i_end; i++)
+      for(uint j = max(j_begin, i + 1); j < j_end; j++){
+        dist = get_distance(operands[i], operands[j], table, cells);
+        row_sums[i - i_begin] += (uint64_t)dist * multiplicities[j];
+        col_sums[j - j_begin] += (uint64_t)dist * multiplicities[i];
+      }
+    lock_guard<mutex> lock(*sums_mutex);
+    for(uint i = i_begin; i < i_end; i++) sums[i] += row_sums[i - i_begin];
+    for(uint j = j_begin; j < j_end; j++) sums[j] += col_sums[j - j_begin];
+    tiles_done++;
+    if(progress_pc) *progress_pc = ((double)tiles_done)/tiles.size();
+    tile_done();
+  }, num_threads);
+
+  if(cancel_computation)
+    if(*cancel_computation) return false;
+  return true;
+}
+
+// compute the sum of distances of each clustering to all clusterings (see above),
+// equal clusterings are only compared once
+inline vector<uint64_t> get_distance_sums(const vector<label_clustering>& clusterings,
+                                          const uint num_threads = 0){
+  const weighted_clusterings distinct(clusterings);
+  vector<uint64_t> distinct_sums, sums(clusterings.size());
+  get_distance_sums(distinct, distinct_sums, [](){}, NULL, (double*)NULL, (const bool*)NULL, num_threads);
+  for(uint i = 0; i < sums.size(); i++) sums[i] = distinct_sums[distinct.index_of[i]];
+  return sums;
+}
+
+// calculate the average distance of a vector of clusterings
+inline double get_avg_distance(const weighted_clusterings& clusterings){
+  uint64_t accu = 0;
+  // every unordered pair is counted in the sums of both of its clusterings
+  vector<uint64_t> sums;
+  get_distance_sums(clusterings, sums, [](){});
+  for(uint i = 0; i < sums.size(); i++) accu += sums[i] * clusterings.multiplicities[i];
+  return ((double)accu)/((double)clusterings.total());
+}
+inline double get_avg_distance(const vector<label_clustering>& clusterings){
+  return get_avg_distance(weighted_clusterings(clusterings));
+}
+// calculate the average distance of the clusterings counted in coassoc, restricted
+// to the pairs of the given elements: c of the m clusterings co-cluster a pair
+// and m-c do not, so c*(m-c) ordered pairs of clusterings disagree on it twice
+// (for matrices of single elements, that is, without super-elements)
+inline double get_avg_distance(const coassociation_matrix& coassoc, const vector<element_id>& elements){
+  if(coassoc.empty()) return 0;
+  uint64_t accu = 0;
+  for(uint i = 0; i < elements.size(); i++)
+    for(uint j = i + 1; j < elements.size(); j++)
+      accu += coassoc.count(elements[i], elements[j]) * coassoc.anti_count(elements[i], elements[j]);
+  return 2.0 * accu / coassoc.num_clusterings();
+}
+
+// return the input clustering with the smallest sum of distances to all input
+// clusterings (the medoid), the sums are computed as above
+// the medoid is a 2-approximation of the consensus: if C_i is the input closest
+// to a consensus C*, then sum_j d(C_i,C_j) <= sum_j d(C_i,C*) + d(C*,C_j) <= 2 d(C*)
+// its cost is written to 'cost' and cost/2 (rounded up), which is a lower bound
+// on the cost of any consensus, to 'lower_bound'
+// the unclustered elements of the medoid form a cluster of their own, as they do
+// in the distances, and an empty clustering is returned if the computation was canceled
+inline label_clustering get_medoid_clustering(const weighted_clusterings& clusterings,
+                                              uint64_t* cost = NULL,
+                                              uint64_t* lower_bound = NULL,
+                                              double* progress_pc = NULL,
+                                              const bool* cancel_computation = NULL,
+                                              const uint num_threads = 0){
+  vector<uint64_t> sums;
+  if(clusterings.empty() ||
+     !get_distance_sums(clusterings, sums, [](){}, NULL, progress_pc, cancel_computation, num_threads))
+    return label_clustering();
+  const uint medoid = min_element(sums.begin(), sums.end()) - sums.begin();
+  if(cost) *cost = sums[medoid];
+  if(lower_bound) *lower_bound = (sums[medoid] + 1) / 2;
+
+  label_clustering result = clusterings.clusterings[medoid];
+  if(result.empty()){
+    // without elements, every clustering is at distance 0
+    if(cost) *cost = 0;
+    if(lower_bound) *lower_bound = 0;
+    if(progress_pc) *progress_pc = 1.0;
+    return result;
+  }
+  const uint32_t unclustered_label = *max_element(result.begin(), result.end()) + 1;
+  for(label_clustering::iterator x = result.begin(); x != result.end(); x++)
+    if(!*x) *x = unclustered_label;
+  if(progress_pc) *progress_pc = 1.0;
+  return result;
+}
+inline label_clustering get_medoid_clustering(const vector<label_clustering>& clusterings,
+                                              uint64_t* cost = NULL,
+                                              uint64_t* lower_bound = NULL,
+                                              const uint num_threads = 0){
+  return get_medoid_clustering(weighted_clusterings(clusterings), cost, lower_bound, NULL, NULL, num_threads);
+}
+
 // calculate the distance between two clusterings
 template <typename T>
 uint get_distance(const clustering<T>& C1, const clustering<T>& C2){
-	uint disagree = 0;
-	// calc for how many unordered pairs the clusterings C1 and C2 disagree
-	for(typename clustering<T>::const_iterator i = C1.begin(); i != C1.end();	i++)
-		for(typename clustering<T>::const_iterator j = i; j != C1.end(); j++) if(i != j)
-			if(coed(i->first, j->first, C1) != coed(i->first, j->first, C2))
-				disagree++;
-	return disagree;
+  element_dictionary<T> elements;
+  for(typename clustering<T>::const_iterator i = C1.begin(); i != C1.end(); i++)
+    elements.insert(i->first);
+  return get_distance(to_label_clustering(C1, elements), to_label_clustering(C2, elements));
 }
 
 // calculate the accumulated distances between a clustering and a vector of clusterings
 template <typename T>
 uint get_distance(const clustering<T>& C, const vector<clustering<T> >& clusterings){
-  uint dist = 0;
-  for(typename vector<clustering<T> >::const_iterator j = clusterings.begin();
-      j != clusterings.end(); j++)
-    dist += get_distance(C, *j);
-  return dist;
+  element_dictionary<T> elements;
+  for(typename clustering<T>::const_iterator i = C.begin(); i != C.end(); i++)
+    elements.insert(i->first);
+  return get_distance(to_label_clustering(C, elements), to_label_clusterings(clusterings, elements));
 }
 
 // calculate the average distance of a vector of clusterings
 template <typename T>
 double get_avg_distance(const vector<clustering<T> >& clusterings){
-	uint accu = 0;
-	// sum up the distance of every pair of clusterings
-	// exploit that d(C,C) == 0  and  d(C1,C2) == d(C2,C1)
-	for(typename vector<clustering<T> >::const_iterator i = clusterings.begin(); i != clusterings.end(); i++)
-		for(typename vector<clustering<T> >::const_iterator j = i; j != clusterings.end(); j++) if(i != j)
-			accu += get_distance(*i,*j);
-	// so far we calculated 1/2 of the accumulated distance
-	return ((double)(accu<<1))/((double)clusterings.size());
+  return get_avg_distance(to_label_clusterings(clusterings, make_element_dictionary(clusterings)));
 }
 
 // merge two disjoint (!) clusterings into one
@@ -186,179 +492,352 @@ clustering<T> merge_clusterings(const clustering<T>& C1, const clustering<T> &C2
   return result;
 }
 
-
-// return whether two elements are predominently coed, antied or dirty
-template <typename T>
-relation get_relation(const iteminfo<T>& info, const T& b){
-  if(info.pred_coed_with.find(b) != info.pred_coed_with.end()) return REL_PRED_COED;
-  if(info.pred_antied_with.find(b) != info.pred_antied_with.end()) return REL_PRED_ANTIED;
-  if(info.dirty_with.find(b) != info.dirty_with.end()) return REL_DIRTY;
-  return REL_UNKNOWN;
+// merge two clusterings of the same elements: the clusters of C2 are added to C1
+// as new clusters, elements that are unclustered in C2 keep their cluster of C1
+inline label_clustering merge_clusterings(const label_clustering& C1, const label_clustering& C2){
+  label_clustering result = C1;
+  uint32_t next_label = 1;
+  for(label_clustering::const_iterator i = C1.begin(); i != C1.end(); i++)
+    next_label = max(next_label, *i + 1);
+  map<uint32_t, uint32_t> new_labels;
+  for(element_id x = 0; x < C2.size(); x++) if(C2[x]){
+    map<uint32_t, uint32_t>::const_iterator l = new_labels.find(C2[x]);
+    if(l == new_labels.end())
+      l = new_labels.insert(pair<uint32_t, uint32_t>(C2[x], next_label++)).first;
+    result[x] = l->second;
+  }
+  return result;
 }
 
-// return whether two elements are predominently coed, antied or dirty
-template <typename T>
-relation get_relation(const T& a, const T& b, const map<T,iteminfo<T> >& infos){
-  // keep in mind that the order of which a and b are given matters !
-  // please make sure that a < b
-  return get_relation(infos[a],b);
-}
+// the preprocessing Rule 1 [see the paper mentioned above] with state that is
+// kept between rounds: the relations of all pairs of unclustered elements are
+// computed once, elements of newly fixed clusters are removed from the relations
+// of their neighbors and only the equivalence classes that contain an element
+// whose class or dirty pairs changed are examined again in the next round,
+// so applying the rule exhaustively costs about as much as one round
+class preprocessing_engine{
+  const coassociation_matrix* coassoc;
+  label_clustering clustering;
+  uint32_t next_label;
+  // the relations among the unclustered elements, which are the active ones
+  relation_store relations;
+  // the elements whose class is examined in the next round
+  vector<element_id> queue;
+  vector<bool> queued;
 
-// set two elements predominently coed, antied or dirty
-template <typename T>
-void set_relation(iteminfo<T> *info, const T& b, const relation r){
-  switch(r){
-    case REL_PRED_COED:
-      info->pred_coed_with.insert(b);
-      break;
-    case REL_PRED_ANTIED:
-      info->pred_antied_with.insert(b);
-      break;
-    case REL_DIRTY:
-      info->dirty_with.insert(b);
-      break;
-    case REL_UNKNOWN:
-      info->pred_coed_with.erase(b);
-      info->pred_antied_with.erase(b);
-      info->dirty_with.erase(b);
-      break;
-  }
-}
-
-// set two elements predominently coed, antied or dirty
-template <typename T>
-void set_relation(const T& a, const T& b, map<T,iteminfo<T> >& infos, const relation r){
-  // keep in mind that the order of which a and b are given matters !
-  // please make sure that a < b
-  set_relation(&infos[a],b,r);
-}
+  void enqueue(const element_id x){
+    if(!queued[x] && !clustering[x]){
+      queued[x] = true;
+      queue.push_back(x);
+    }
+  }
+  // the classes containing x change if x is removed or changes its dirty pairs
+  void enqueue_classes_of(const element_id x){
+    relations.for_each_coed(x, [this](const element_id y){ enqueue(y); });
+  }
+  // remove the clustered element x from the relations of its neighbors
+  void remove(const element_id x){
+    relations.deactivate(x);
+    relations.for_each_dirty(x, [this](const element_id y){ enqueue_classes_of(y); });
+    relations.for_each_coed(x, [this](const element_id y){ enqueue_classes_of(y); });
+  }
 
-// compute the number of dirty pairs related to the eq-class
-// this can be done by summing up |dirty_with[x]| for all x in dirty_part
-template <typename T>
-uint num_dirty_pairs(const set<T>& elements, const map<T,iteminfo<T> >& infos){
-   uint dirty_pairs = 0;
-   typename map<T,iteminfo<T> >::const_iterator info_iterator;
-   for(typename set<T>::const_iterator x = elements.begin(); x != elements.end(); x++)
-     if((info_iterator = infos.find(*x)) != infos.end())
-       dirty_pairs += info_iterator->second.dirty_with.size();
-   return dirty_pairs;
-}
+public:
+  // compute the relations of all pairs of elements that are unclustered in
+  // 'partial_clustering', if the computation is canceled, the engine is done()
+  // the rows of pairs are classified on num_threads threads (0 = one per core)
+  preprocessing_engine(const coassociation_matrix& _coassoc,
+                       const label_clustering& partial_clustering = label_clustering(),
+                       double* progress_pc = NULL,
+                       const bool* cancel_computation = NULL,
+                       const uint num_threads = 0):
+    coassoc(&_coassoc), clustering(partial_clustering), next_label(1)
+  {
+    // if the partial clustering is new, set all items to unclustered
+    if(clustering.empty()) clustering = label_clustering(coassoc->num_elements());
+    for(label_clustering::const_iterator i = clustering.begin(); i != clustering.end(); i++)
+      next_label = max(next_label, *i + 1);
+    queued.assign(clustering.size(), false);
+    relations = relation_store(clustering.size());
+    for(element_id x = 0; x < clustering.size(); x++)
+      if(clustering[x]) relations.deactivate(x);
+    if(coassoc->empty()) return;
+
+    const vector<element_id> unclustered = get_unclustered_elements(clustering);
+    const uint m = coassoc->num_clusterings();
+    const double all_steps = ((double)unclustered.size() + 1) * unclustered.size() / 2;
+    atomic<uint64_t> steps(0);
+    // for each pair of elements, compute whether they are predominantly
+    // co-clustered, anti-clustered, or form a dirty pair
+    // the thread of row i only writes the pairs of unclustered[i] with larger elements
+    parallel_for(0, unclustered.size(), [&](const uint i){
+      if(cancel_computation)
+        if(*cancel_computation) return;
+      const element_id x = unclustered[i];
+      for(uint j = i + 1; j < unclustered.size(); j++){
+        const relation r = classify_pair(coassoc->count(x, unclustered[j]), m);
+        if(r != REL_PRED_ANTIED) relations.set_upper_relation(x, unclustered[j], r);
+      }
+      const uint64_t done = (steps += unclustered.size() - i);
+      if(progress_pc) *progress_pc = done / all_steps;
+    }, num_threads);
+    if(cancel_computation)
+      if(*cancel_computation){ queue.clear(); return; }
+    relations.complete_upper_relations(num_threads);
+    for(vector<element_id>::const_iterator i = unclustered.begin(); i != unclustered.end(); i++)
+      enqueue(*i);
+    if(progress_pc) *progress_pc = 1;
+  }
 
+  // return whether there is nothing left to examine
+  bool done() const { return queue.empty(); }
+  // the partial clustering computed so far
+  const label_clustering& get_clustering() const { return clustering; }
+  // the relations of the elements that are still unclustered
+  const relation_store& get_relations() const { return relations; }
 
-// apply the preprocessing Rule 1 [see the paper mentioned above] exhaustively
-// and return a partial solution
+  // examine the equivalence classes of all queued elements once and fix each
+  // class whose non-dirty part is larger than its dirty pairs as a cluster,
+  // return the number of newly clustered elements
+  uint apply_round(double* progress_pc = NULL, const bool* cancel_computation = NULL){
+    vector<element_id> work;
+    work.swap(queue);
+    for(vector<element_id>::const_iterator x = work.begin(); x != work.end(); x++) queued[*x] = false;
+
+    uint newly_clustered = 0;
+    vector<element_id> clean_part, dirty_part, equiv_class;
+    for(vector<element_id>::const_iterator i = work.begin(); i != work.end(); i++){
+      if(progress_pc) *progress_pc = ((double)(i - work.begin()))/work.size();
+      if(cancel_computation)
+        if(*cancel_computation){ queue.clear(); return newly_clustered; }
+      // only classes of clean unclustered elements qualify
+      if(clustering[*i] || relations.dirty_degree(*i)) continue;
+
+      // its equivalence class is the set of all co-clustered elements
+      equiv_class.clear();
+      relations.for_each_coed(*i, [&equiv_class](const element_id y){ equiv_class.push_back(y); });
+      // we split those elements in dirty and clean ones
+      clean_part.clear();
+      dirty_part.clear();
+      for(vector<element_id>::const_iterator x = equiv_class.begin(); x != equiv_class.end(); x++)
+        if(relations.dirty_degree(*x)) dirty_part.push_back(*x); else clean_part.push_back(*x);
+
+      // if now the non-dirty part is larger than the dirty pairs,
+      // then the eq-class is part of the optimal clustering
+      if(clean_part.size() > relations.num_dirty_pairs(dirty_part)){
+        for(vector<element_id>::const_iterator x = equiv_class.begin(); x != equiv_class.end(); x++)
+          clustering[*x] = next_label;
+        next_label++;
+        newly_clustered += equiv_class.size();
+        for(vector<element_id>::const_iterator x = equiv_class.begin(); x != equiv_class.end(); x++)
+          remove(*x);
+      }
+    }
+    if(progress_pc) *progress_pc = 1;
+    return newly_clustered;
+  }
+
+  // apply rounds until no class is left to examine, return the number of
+  // newly clustered elements
+  uint apply_exhaustively(double* progress_pc = NULL, const bool* cancel_computation = NULL){
+    uint newly_clustered = 0;
+    while(!done()) newly_clustered += apply_round(progress_pc, cancel_computation);
+    return newly_clustered;
+  }
+};
+
+// apply one round of the preprocessing Rule 1 (see above) and return a partial solution
 // we assume all clusterings to be over the same set of elements
+inline label_clustering apply_preprocessing(const coassociation_matrix& coassoc,
+    const label_clustering& partial_clustering = label_clustering(),
+    double* progress_pc = NULL,
+    const bool* cancel_computation = NULL){
+  if(coassoc.empty() && partial_clustering.empty()) return partial_clustering;
+  preprocessing_engine engine(coassoc, partial_clustering, progress_pc, cancel_computation);
+  engine.apply_round(progress_pc, cancel_computation);
+  if(cancel_computation)
+    if(*cancel_computation) return label_clustering();
+  return engine.get_clustering();
+}
+
+// apply the preprocessing Rule 1 (see above) to a vector of clusterings
+inline label_clustering apply_preprocessing(const vector<label_clustering>& clusterings,
+    const label_clustering& partial_clustering = label_clustering(),
+    double* progress_pc = NULL,
+    const bool* cancel_computation = NULL){
+  if(clusterings.empty()) return partial_clustering;
+  const coassociation_matrix coassoc(clusterings, 0, cancel_computation);
+  if(coassoc.empty()) return label_clustering();
+  return apply_preprocessing(coassoc, partial_clustering, progress_pc, cancel_computation);
+}
+
+// apply the preprocessing Rule 1 on named elements,
+// the work is done on the dense representation
 template <typename T>
 clustering<T> apply_preprocessing(const vector<clustering<T> >& clusterings,
     const clustering<T>& partial_clustering = clustering<T>(),
     double* progress_pc = NULL,
     const bool* cancel_computation = NULL){
-  set<T> unclustered;
-  set<T> global_dirty;    // set of all dirty items
-  map<T,iteminfo<T> >  infos;
+  if(clusterings.empty()) return partial_clustering;
+  const element_dictionary<T> elements = make_element_dictionary(clusterings);
+  return to_clustering(apply_preprocessing(to_label_clusterings(clusterings, elements),
+                                           to_label_clustering(partial_clustering, elements),
+                                           progress_pc, cancel_computation), elements);
+}
 
-  // first, make a non-constant copy of the partial clustering
-  clustering<T> optimal_clustering(partial_clustering);
-  // if the current_clustering is new, set all items to unclustered
-  if(optimal_clustering == clustering<T>()){
-    if(clusterings.size()){
-    for(typename clustering<T>::const_iterator i = clusterings.begin()->begin();
-      i != clusterings.begin()->end(); i++)
-      optimal_clustering.insert(pair<T,uint>(i->first,0));
-    } else return optimal_clustering;
-  }
-
-  unclustered = get_unclustered_elements(optimal_clustering);
-
-  if(unclustered.size()){
-	  // calculate the number of steps that will be taken
-	  uint all_steps = unclustered.size();
-	  all_steps = ((all_steps + 1) * all_steps) >> 1;
-	  // so far, 0 steps have been taken
-	  uint steps = 0;
-
-	  // for each element, compute its infos, that is, the sets of elements that are
-	  // predominantly co-clustered, anti-clustered, or form a dirty pair with it
-	  uint count_coed;
-	  for(typename set<T>::const_iterator i = unclustered.begin(); i != unclustered.end(); i++){
-	    infos[*i].pred_coed_with.insert(*i);
-	//    info = &infos[i->first];
-	    for(typename set<T>::const_iterator j = i; j != unclustered.end(); j++) if(i != j){
-	      if(progress_pc) *progress_pc = ((double)steps)/all_steps;
-	      if(cancel_computation)
-	        if(*cancel_computation) return clustering<T>();
-	      // compute the relation by iterating over the clusterings
-	      count_coed = 0;
-		    for(typename vector<clustering<T> >::const_iterator C = clusterings.begin();
-	          C != clusterings.end(); C++)
-	        if(coed(*i, *j, *C)) count_coed++;
-	      // check whether (i,j) are predominantly coed, antied or dirty
-	      if(count_coed < ((double)clusterings.size())/3){
-	        infos[*i].pred_antied_with.insert(*j);  // predominantly antied
-	        infos[*j].pred_antied_with.insert(*i);  // predominantly antied
-	      } else {
-	        if(count_coed > ((double)(clusterings.size()*2))/3){
-	          infos[*i].pred_coed_with.insert(*j);  // predominantly coed
-	          infos[*j].pred_coed_with.insert(*i);  // predominantly coed
-	        } else {
-	          infos[*i].dirty_with.insert(*j);      // neither predominently coed, nor antied
-	          infos[*j].dirty_with.insert(*i);      // neither predominently coed, nor antied
-	          global_dirty.insert(*i);
-	          global_dirty.insert(*j);
-	        }
-	      }
-	      steps++;
-	    }
-	  }
-
-
-	  // now, walk through the elements and construct their equivalence classes
-	  for(typename set<T>::const_iterator i = unclustered.begin(); i != unclustered.end(); i++){
-	    infos[*i].accounted_for = false;
-	//    optimal_clustering[*i] = 0; // 0 = not clustered yet
-	  }
-	  set<T> clean_part, dirty_part, equiv_class, dirty_equiv_class;
-	  for(typename set<T>::const_iterator i = unclustered.begin(); i != unclustered.end(); i++){
-	    if(progress_pc) *progress_pc = ((double)steps)/all_steps;
-	    if(cancel_computation)
-	      if(*cancel_computation) return clustering<T>();
-
-	    clean_part.clear();
-	    dirty_part.clear();
-	    // get the first element in the list that is not dirty or already accounted for
-	    if((!infos[*i].accounted_for) && (global_dirty.find(*i) == global_dirty.end())){
-		      // its equivalence class is the set of all co-clustered elements
-		      equiv_class = infos[*i].pred_coed_with;
-
-	        // we split those elements in dirty and clean ones by intersecting with global_dirty
-		      set_intersection(equiv_class.begin(), equiv_class.end(),
-		            global_dirty.begin(), global_dirty.end(), inserter(dirty_part, dirty_part.begin()));
-		      set_difference(equiv_class.begin(), equiv_class.end(),
-		            dirty_part.begin(), dirty_part.end(), inserter(clean_part, clean_part.begin()));
-
-	        // if now the non-dirty part is larger than the dirty pairs,
-	        // then the eq-class is part of the optimal clustering
-	        if(clean_part.size() > num_dirty_pairs(dirty_part, infos)){
-		        // add the eq-class as a cluster to optimal_clustering
-		        add_cluster(optimal_clustering, equiv_class);
-		        // remove the elements in the eq-class from all clusterings
-	 //         remove_elements(clusterings, equiv_class);
-		        // mark the members of the eq-class as accounted for
-	          for(typename set<T>::const_iterator x = equiv_class.begin(); x != equiv_class.end(); x++)
-		          infos[*x].accounted_for = true;
-	        }
-	    }
-	    steps++;
-	  }
-	  if(progress_pc) *progress_pc = ((double)steps)/all_steps;
+// one level of the enumeration of get_consensus_clustering_brute
+class brute_force_frame{
+public:
+  uint32_t label;       // the cluster the element of this level is in, 0 before the first
+  uint32_t max_label;   // the largest label used by the levels above
+  uint64_t cost;        // the accumulated distance on the pairs clustered above this level
+  double current_pc;    // the progress when the current label was started
+  double max_pc;        // the progress when this level is done
+};
+
+// enumerate all completions of 'current' as restricted growth strings: the
+// unclustered elements (in the order of their ids) are put into the clusters
+// 1...max_label+1 one after the other, where max_label is the largest label
+// used before. The walk works in place on 'current', the levels are kept on an
+// explicit stack that is used to undo the assignments when backtracking and all
+// buffers are allocated before the walk, so the nodes do not allocate
+// 'cost' is the accumulated distance of 'current' on its clustered elements,
+// the costs of all clusters of an element are computed when its level is entered
+// the first complete clustering of minimum distance is stored in 'min_clustering'
+inline void brute_force_search(const coassociation_matrix& coassoc,
+                               label_clustering& current,
+                               const uint64_t cost,
+                               label_clustering& min_clustering,
+                               uint64_t& min_distance,
+                               double *progress_pc,
+                               const bool* cancel_computation,
+                               const double current_pc,
+                               const double max_pc)
+{
+  const vector<element_id> order = get_unclustered_elements(current);
+  const uint k = order.size();
+  uint32_t max_label = 0;
+  for(label_clustering::const_iterator i = current.begin(); i != current.end(); i++)
+    max_label = max(max_label, *i);
+  if(!k){
+    min_distance = cost;
+    min_clustering = current;
+    return;
+  }
+  // row d holds the costs of all clusters for order[d]
+  const uint row_size = max_label + k + 2;
+  vector<uint64_t> costs((size_t)k * row_size);
+  vector<brute_force_frame> stack(k);
+  // min_clustering keeps its size, so storing a clustering does not allocate
+  min_clustering = current;
+
+  brute_force_frame& root = stack[0];
+  root.label = 0;
+  root.max_label = max_label;
+  root.cost = cost;
+  root.current_pc = current_pc;
+  root.max_pc = max_pc;
+  get_assignment_costs(coassoc, current, order[0], max_label, &costs[0]);
+
+  uint d = 0;
+  while(true){
+    if(cancel_computation)
+      if(*cancel_computation) return;
+    brute_force_frame& f = stack[d];
+    const element_id x = order[d];
+    const uint32_t num_options = f.max_label + 1;
+    if(f.label){
+      // undo the last assignment of this level
+      current[x] = 0;
+      f.current_pc += (f.max_pc - f.current_pc)/num_options;
+      // user do not notice any increase below 1%
+      if(f.max_pc - f.current_pc > 0.01)
+        if(progress_pc) *progress_pc = f.current_pc;
+    }
+    // if all clusters were tried (or nothing can be better), backtrack
+    if((f.label == num_options) || (min_distance == 0)){
+      if(progress_pc) *progress_pc = f.max_pc;
+      if(!d) break;
+      d--;
+      continue;
+    }
+    const uint32_t label = ++f.label;
+    const uint64_t new_cost = f.cost + costs[(size_t)d * row_size + label];
+    current[x] = label;
+    if(d + 1 == k){
+      // all elements are clustered, 'new_cost' is the accumulated distance of current
+      if(new_cost < min_distance){
+        min_distance = new_cost;
+        min_clustering = current;
+      }
+      continue;
+    }
+    // ... else, enter the next level
+    brute_force_frame& child = stack[d + 1];
+    child.label = 0;
+    child.max_label = max(f.max_label, label);
+    child.cost = new_cost;
+    child.current_pc = f.current_pc;
+    child.max_pc = f.current_pc + (f.max_pc - f.current_pc)/num_options;
+    d++;
+    get_assignment_costs(coassoc, current, order[d], child.max_label, &costs[(size_t)d * row_size]);
   }
-  return optimal_clustering;
 }
 
 // complete (assign clusters to all unclustered elements) the given optimal
 // clustering by performing a brute force search on the clusterings getting
 // the optimal consensus clustering for the given instance
+inline label_clustering get_consensus_clustering_brute(const coassociation_matrix& coassoc,
+                                            label_clustering current_clustering = label_clustering(),
+                                            double *progress_pc = NULL,
+                                            const bool* cancel_computation = NULL,
+                                            double current_pc = 0,
+                                            double max_pc = 1)
+{
+  if(cancel_computation)
+      if(*cancel_computation) return label_clustering();
+  // if the current_clustering is new, set all items to unclustered
+  if(current_clustering.empty()){
+    if(!coassoc.empty())
+      current_clustering = label_clustering(coassoc.num_elements());
+    else return current_clustering;
+  }
+
+  // the accumulated distance on the pairs that are already clustered
+  uint64_t cost = 0;
+  for(element_id i = 0; i < current_clustering.size(); i++) if(current_clustering[i])
+    for(element_id j = i + 1; j < current_clustering.size(); j++) if(current_clustering[j])
+      cost += coed(i, j, current_clustering) ? coassoc.anti_count(i, j) : coassoc.count(i, j);
+
+  label_clustering min_clustering;
+  uint64_t min_distance = (uint64_t)-1;
+  brute_force_search(coassoc, current_clustering, cost, min_clustering, min_distance,
+                     progress_pc, cancel_computation, current_pc, max_pc);
+
+  if(cancel_computation)
+      if(*cancel_computation) return label_clustering();
+  // the incremental costs must add up to the accumulated distance
+  assert(get_distance(min_clustering, coassoc) == min_distance);
+  return min_clustering;
+}
+
+// brute force search (see above) on a vector of clusterings
+inline label_clustering get_consensus_clustering_brute(const vector<label_clustering>& clusterings,
+                                            const label_clustering& current_clustering = label_clustering(),
+                                            double *progress_pc = NULL,
+                                            const bool* cancel_computation = NULL,
+                                            double current_pc = 0,
+                                            double max_pc = 1)
+{
+  if(clusterings.empty()) return current_clustering;
+  const coassociation_matrix coassoc(clusterings, 0, cancel_computation);
+  if(coassoc.empty()) return label_clustering();
+  return get_consensus_clustering_brute(coassoc, current_clustering, progress_pc,
+                                        cancel_computation, current_pc, max_pc);
+}
+
+// brute force search on named elements, the search itself runs on the
+// dense representation and only the result is mapped back to the names
 template <typename T>
 clustering<T> get_consensus_clustering_brute(const vector<clustering<T> >& clusterings,
                                             clustering<T> current_clustering = clustering<T>(),
@@ -366,75 +845,345 @@ clustering<T> get_consensus_clustering_brute(const vector<clustering<T> >& clust
                                             const bool* cancel_computation = NULL,
                                             double current_pc = 0,
                                             double max_pc = 1)
+{
+  if(clusterings.empty()) return current_clustering;
+  const element_dictionary<T> elements = make_element_dictionary(clusterings);
+  return to_clustering(get_consensus_clustering_brute(to_label_clusterings(clusterings, elements),
+                                           to_label_clustering(current_clustering, elements),
+                                           progress_pc, cancel_computation,
+                                           current_pc, max_pc), elements);
+}
+
+
+// complete the given clustering to an optimal consensus clustering
+// using the given search method on num_threads threads (0 = one per core)
+// the parallel search always uses the engine of cclust_search.h, for the
+// brute force method it runs without lower bounds
+// the average parameterized search is limited to the budget (see cclust_fpt.h)
+// for the brute force method, instances of at most SUBSET_DP_MAX_ELEMENTS units
+// are solved by the dynamic program of cclust_subset_dp.h instead
+inline label_clustering get_consensus_clustering_exact(const coassociation_matrix& coassoc,
+                                            const label_clustering& current_clustering = label_clustering(),
+                                            const search_method method = SEARCH_BRUTE_FORCE,
+                                            double *progress_pc = NULL,
+                                            const bool* cancel_computation = NULL,
+                                            const uint num_threads = 1,
+                                            const uint64_t budget = (uint64_t)-1)
+{
+  switch(method){
+    case SEARCH_AVERAGE_PARAMETERIZED:
+      return get_consensus_clustering_fpt(coassoc, current_clustering, budget,
+                                          progress_pc, cancel_computation);
+    case SEARCH_BRANCH_AND_BOUND:
+      return get_consensus_clustering_bnb(coassoc, current_clustering, progress_pc,
+                                          cancel_computation, num_threads);
+    default:
+      if((current_clustering.empty() ? coassoc.num_elements() : get_num_units(current_clustering)) <= SUBSET_DP_MAX_ELEMENTS)
+        return get_consensus_clustering_subset_dp(coassoc, current_clustering, progress_pc, cancel_computation);
+      if(num_worker_threads(num_threads) > 1)
+        return get_consensus_clustering_bnb(coassoc, current_clustering, progress_pc,
+                                            cancel_computation, num_threads, false);
+      return get_consensus_clustering_brute(coassoc, current_clustering, progress_pc, cancel_computation);
+  }
+}
+
+// find the root of x in the union-find forest 'parent', halving the path
+inline element_id find_root(vector<element_id>& parent, element_id x){
+  while(parent[x] != x) x = parent[x] = parent[parent[x]];
+  return x;
+}
+
+// split the instance into parts that can be solved independently: the nodes
+// are the unclustered elements and the clusters of current_clustering, two
+// nodes are adjacent if the majority of the clusterings co-clusters them (for
+// a cluster, summed over its members). If a clustering has a cluster spanning
+// two parts, splitting it does not increase the accumulated distance, so
+// solving the parts separately is exact. (the parts are finer than the
+// components of the dirty/co-clustered relation of the preprocessing)
+// each part lists the elements of its nodes, parts without unclustered
+// elements are not returned, the largest part comes first
+inline vector<vector<element_id> > get_independent_parts(const coassociation_matrix& coassoc,
+                                                         const label_clustering& current_clustering){
+  const uint n = current_clustering.size();
+  vector<element_id> parent(n);
+  for(element_id x = 0; x < n; x++) parent[x] = x;
+  // the members of a cluster are joined with its first member
+  uint32_t max_label = 0;
+  for(element_id x = 0; x < n; x++) max_label = max(max_label, current_clustering[x]);
+  vector<element_id> first_member(max_label + 1, NO_ELEMENT);
+  for(element_id x = 0; x < n; x++) if(current_clustering[x]){
+    element_id& first = first_member[current_clustering[x]];
+    if(first == NO_ELEMENT) first = x;
+    else parent[find_root(parent, x)] = find_root(parent, first);
+  }
+
+  // weight[c]: how much the clusterings favor putting x into cluster c
+  vector<int64_t> weight(max_label + 1, 0);
+  for(element_id x = 0; x < n; x++) if(!current_clustering[x]){
+    for(element_id y = 0; y < n; y++) if(y != x){
+      const int64_t excess = (int64_t)coassoc.count(x, y) - (int64_t)coassoc.anti_count(x, y);
+      if(current_clustering[y])
+        weight[current_clustering[y]] += excess;
+      else if((y > x) && (excess > 0))
+        parent[find_root(parent, y)] = find_root(parent, x);
+    }
+    for(uint32_t c = 1; c <= max_label; c++){
+      if((weight[c] > 0) && (first_member[c] != NO_ELEMENT))
+        parent[find_root(parent, first_member[c])] = find_root(parent, x);
+      weight[c] = 0;
+    }
+  }
+
+  // collect the parts containing unclustered elements
+  vector<uint> part_of(n, (uint)-1);
+  vector<vector<element_id> > parts;
+  for(element_id x = 0; x < n; x++) if(!current_clustering[x]){
+    const element_id root = find_root(parent, x);
+    if(part_of[root] == (uint)-1){
+      part_of[root] = parts.size();
+      parts.push_back(vector<element_id>());
+    }
+  }
+  for(element_id x = 0; x < n; x++){
+    const uint p = part_of[find_root(parent, x)];
+    if(p != (uint)-1) parts[p].push_back(x);
+  }
+  stable_sort(parts.begin(), parts.end(),
+              [](const vector<element_id>& a, const vector<element_id>& b){ return a.size() > b.size(); });
+  return parts;
+}
+
+// apply the reduction rules of cclust_reductions.h to the instance and solve the
+// remaining kernel, in which each group of merged elements is one super-element
+// and the isolated groups are left out, by the exact search. The hits of each of
+// the rules are added to rule_hits (if given). The budget of the average
+// parameterized search is lowered by the cost of the pairs outside of the kernel
+inline label_clustering get_consensus_clustering_kernel(const coassociation_matrix& coassoc,
+                                            const label_clustering& current_clustering,
+                                            const search_method method = SEARCH_BRUTE_FORCE,
+                                            double *progress_pc = NULL,
+                                            const bool* cancel_computation = NULL,
+                                            const uint num_threads = 1,
+                                            const uint64_t budget = (uint64_t)-1,
+                                            vector<uint>* rule_hits = NULL)
+{
+  const uint n = current_clustering.size();
+  if(n > MAX_REDUCTION_ELEMENTS)
+    return get_consensus_clustering_exact(coassoc, current_clustering, method,
+                                          progress_pc, cancel_computation, num_threads, budget);
+  reduction_kernel K(coassoc, current_clustering);
+  vector<reduction_rule> rules = get_default_reduction_rules();
+  reduce_to_fixpoint(K, rules, cancel_computation);
+  if(rule_hits){
+    rule_hits->resize(rules.size(), 0);
+    for(uint r = 0; r < rules.size(); r++) (*rule_hits)[r] += rules[r].hits;
+  }
+
+  // the groups of the kernel
+  vector<uint> group_of(n, (uint)-1);
+  for(uint g = 0; g < K.groups.size(); g++) group_of[K.groups[g]] = g;
+  vector<vector<element_id> > groups(K.groups.size());
+  label_clustering kernel_clustering(K.groups.size());
+  for(uint g = 0; g < K.groups.size(); g++) kernel_clustering[g] = K.labels[K.groups[g]];
+  vector<element_id> root(n);
+  for(element_id x = 0; x < n; x++){
+    root[x] = K.find(x);
+    if(!K.isolated[root[x]]) groups[group_of[root[x]]].push_back(x);
+  }
+  uint64_t outside = 0;
+  for(element_id x = 0; x < n; x++)
+    for(element_id y = x + 1; y < n; y++)
+      if(root[x] == root[y]) outside += coassoc.anti_count(x, y);
+      else if(K.isolated[root[x]] || K.isolated[root[y]]) outside += coassoc.count(x, y);
+
+  label_clustering solution;
+  if(!groups.empty()){
+    const coassociation_matrix kernel(coassoc, groups);
+    solution = get_consensus_clustering_exact(kernel, kernel_clustering, method,
+                                              progress_pc, cancel_computation, num_threads,
+                                              (budget > outside) ? budget - outside : 0);
+    if(solution.empty()) return solution;
+  }
+  // the isolated groups get labels of their own
+  uint32_t next_label = 1;
+  for(label_clustering::const_iterator l = solution.begin(); l != solution.end(); l++)
+    next_label = max(next_label, *l + 1);
+  vector<uint32_t> isolated_label(n, 0);
+  label_clustering result(n);
+  for(element_id x = 0; x < n; x++)
+    if(K.isolated[root[x]]){
+      if(!isolated_label[root[x]]) isolated_label[root[x]] = next_label++;
+      result[x] = isolated_label[root[x]];
+    } else result[x] = solution[group_of[root[x]]];
+  if(progress_pc) *progress_pc = 1;
+  return result;
+}
+
+// solve the sub-instance induced by the elements of a part (see above) on a
+// reduced instance: each cluster of current_clustering and each group of
+// twins, that is, unclustered elements that all clusterings co-cluster,
+// becomes one weighted super-element, since there is an optimal clustering
+// keeping twins together. The reduced instance is then solved as a kernel (see
+// above). The labels of 'elements' in the solution are returned
+inline label_clustering get_consensus_clustering_reduced(const coassociation_matrix& coassoc,
+                                            const vector<element_id>& elements,
+                                            const label_clustering& current_clustering,
+                                            const search_method method = SEARCH_BRUTE_FORCE,
+                                            double *progress_pc = NULL,
+                                            const bool* cancel_computation = NULL,
+                                            const uint num_threads = 1,
+                                            vector<uint>* rule_hits = NULL)
+{
+  const uint NO_GROUP = (uint)-1;
+  vector<uint> group_of(elements.size(), NO_GROUP);
+  vector<vector<element_id> > groups;
+  label_clustering reduced_clustering;
+  map<uint32_t, uint> group_of_label;
+  for(uint i = 0; i < elements.size(); i++) if(group_of[i] == NO_GROUP){
+    const element_id x = elements[i];
+    const uint32_t label = current_clustering[x];
+    if(label){
+      // a cluster is one group
+      map<uint32_t, uint>::const_iterator g = group_of_label.find(label);
+      if(g == group_of_label.end()){
+        g = group_of_label.insert(pair<uint32_t, uint>(label, groups.size())).first;
+        groups.push_back(vector<element_id>());
+        reduced_clustering.push_back(label);
+      }
+      group_of[i] = g->second;
+      groups[g->second].push_back(x);
+    } else {
+      // x and its unclustered twins are one group
+      groups.push_back(vector<element_id>());
+      reduced_clustering.push_back(0);
+      for(uint j = i; j < elements.size(); j++)
+        if((group_of[j] == NO_GROUP) && !current_clustering[elements[j]])
+          if((j == i) || !coassoc.anti_count(x, elements[j])){
+            group_of[j] = groups.size() - 1;
+            groups.back().push_back(elements[j]);
+          }
+    }
+  }
+
+  // the average distance restricted to the part bounds the cost of its consensus,
+  // the pairs inside of the groups are not part of the reduced instance
+  uint64_t budget = (uint64_t)-1;
+  if(method == SEARCH_AVERAGE_PARAMETERIZED){
+    uint64_t inside = 0;
+    for(vector<vector<element_id> >::const_iterator g = groups.begin(); g != groups.end(); g++)
+      for(uint a = 0; a < g->size(); a++)
+        for(uint b = a + 1; b < g->size(); b++)
+          inside += coassoc.anti_count((*g)[a], (*g)[b]);
+    const uint64_t avg_distance = (uint64_t)get_avg_distance(coassoc, elements);
+    budget = (avg_distance > inside) ? avg_distance - inside : 0;
+  }
+
+  const coassociation_matrix reduced(coassoc, groups);
+  const label_clustering solution = get_consensus_clustering_kernel(reduced, reduced_clustering, method,
+                                                                    progress_pc, cancel_computation, num_threads,
+                                                                    budget, rule_hits);
+  if(solution.empty()) return solution;
+  label_clustering result(elements.size());
+  for(uint i = 0; i < elements.size(); i++) result[i] = solution[group_of[i]];
+  return result;
+}
+
+// complete the given clustering to an optimal consensus clustering by solving
+// the independent parts of the instance (see above) as separate, reduced
+// sub-instances, concurrently on num_threads threads (0 = one per core), and
+// merging their solutions. If there is only one part, it gets all threads
+// the hits of the reduction rules on all parts are added to rule_hits (if given)
+inline label_clustering get_consensus_clustering_search(const coassociation_matrix& coassoc,
+                                            label_clustering current_clustering = label_clustering(),
+                                            const search_method method = SEARCH_BRUTE_FORCE,
+                                            double *progress_pc = NULL,
+                                            const bool* cancel_computation = NULL,
+                                            const uint num_threads = 1,
+                                            vector<uint>* rule_hits = NULL)
 {
   if(cancel_computation)
-      if(*cancel_computation) return clustering<T>();
+    if(*cancel_computation) return label_clustering();
   // if the current_clustering is new, set all items to unclustered
-  if(current_clustering == clustering<T>()){
-    if(clusterings.size()){
-      for(typename clustering<T>::const_iterator i = clusterings.begin()->begin();
-       i != clusterings.begin()->end(); i++)
-        current_clustering.insert(pair<T,uint>(i->first,0));
-    } else return current_clustering;
-  }
-  // find the first unclustered element
-  T *first_unclustered = NULL;
-  for(typename clustering<T>::const_iterator i = current_clustering.begin();
-      i != current_clustering.end(); i++)
-    if(!i->second) { first_unclustered = new T(i->first); break;}
-  // if all elemtents are clustered, return the current clustering...
-  if(!first_unclustered) return current_clustering;
-
-  // ... else, try to put it into clusters 1...num_clusters+1 and branch
-  clustering<T> best_clustering;
-  uint max_cluster = num_clusters(current_clustering) + 1;
-  uint dist = 0;
-  uint min_distance = (uint)-1;
-  clustering<T> min_clustering;
-  for(uint cluster = 1; cluster <= max_cluster; cluster++){
-    current_clustering[*first_unclustered] = cluster;
-    best_clustering = get_consensus_clustering_brute(clusterings, current_clustering,
-        progress_pc, cancel_computation,
-        current_pc , current_pc + (max_pc - current_pc)/max_cluster);
-    current_pc += (max_pc - current_pc)/max_cluster;
-
-    // user do not notice any increase below 1%
-    if(max_pc - current_pc > 0.01)
-      if(progress_pc) *progress_pc = current_pc;
-
-    // accumulated distance to all clusterings
-    dist = get_distance(best_clustering, clusterings);
-    if(dist < min_distance){
-      min_distance = dist;
-      min_clustering = best_clustering;
+  if(current_clustering.empty()){
+    if(!coassoc.empty())
+      current_clustering = label_clustering(coassoc.num_elements());
+    else return current_clustering;
+  }
+  const vector<vector<element_id> > parts = get_independent_parts(coassoc, current_clustering);
+
+  vector<label_clustering> solutions(parts.size());
+  vector<vector<uint> > part_hits(parts.size());
+  if(parts.size() == 1)
+    solutions[0] = get_consensus_clustering_reduced(coassoc, parts[0], current_clustering, method,
+                                                    progress_pc, cancel_computation, num_threads,
+                                                    &part_hits[0]);
+  else {
+    // solve each part on its own elements
+    atomic<uint> parts_done(0);
+    parallel_for(0, parts.size(), [&](const uint p){
+      solutions[p] = get_consensus_clustering_reduced(coassoc, parts[p], current_clustering, method,
+                                                      NULL, cancel_computation, 1, &part_hits[p]);
+      if(progress_pc) *progress_pc = (double)(++parts_done) / parts.size();
+    }, num_threads);
+  }
+  if(rule_hits)
+    for(uint p = 0; p < parts.size(); p++){
+      rule_hits->resize(max(rule_hits->size(), part_hits[p].size()), 0);
+      for(uint r = 0; r < part_hits[p].size(); r++) (*rule_hits)[r] += part_hits[p][r];
+    }
+  if(cancel_computation)
+    if(*cancel_computation) return label_clustering();
+
+  // the clusters outside of all parts stay, the solutions of the parts are added
+  label_clustering result = current_clustering;
+  for(uint p = 0; p < parts.size(); p++){
+    label_clustering part_result(result.size());
+    for(element_id i = 0; i < parts[p].size(); i++){
+      result[parts[p][i]] = 0;
+      part_result[parts[p][i]] = solutions[p][i];
     }
-    if(min_distance == 0) break;
+    result = merge_clusterings(result, part_result);
   }
-  if(progress_pc) *progress_pc = max_pc;
-  delete first_unclustered;
-  return min_clustering;
+  if(progress_pc) *progress_pc = 1;
+  return result;
 }
 
-
 // calculate a clustering with minimum sum of distances to all given clusterings
 // we assume all clusterings to be over the same set of elements
+inline label_clustering get_consensus_clustering(const vector<label_clustering>& clusterings,
+                                      const bool do_preprocessing = true,
+                                      double* preprocessing_percent = NULL,
+                                      double* brute_force_percent = NULL,
+                                      const search_method method = SEARCH_BRUTE_FORCE,
+                                      const uint num_threads = 1){
+  label_clustering optimal_clustering;
+  if(clusterings.empty()) return optimal_clustering;
+  // count the co-clusterings once for all the following steps
+  const coassociation_matrix coassoc(clusterings);
+  // apply preprocessing exhaustively
+  if(do_preprocessing){
+    preprocessing_engine engine(coassoc, optimal_clustering, preprocessing_percent);
+    engine.apply_exhaustively(preprocessing_percent);
+    optimal_clustering = engine.get_clustering();
+  }
+  // and search on the remaining instance
+  optimal_clustering = get_consensus_clustering_search(coassoc, optimal_clustering, method,
+                                                       brute_force_percent, NULL, num_threads);
+  return optimal_clustering;
+}
+
+// calculate a consensus clustering of named elements
 template <typename T>
 clustering<T> get_consensus_clustering(vector<clustering<T> >& clusterings,
                                       const bool do_preprocessing = true,
                                       double* preprocessing_percent = NULL,
-                                      double* brute_force_percent = NULL){
-  clustering<T> optimal_clustering;
-  uint old_clustered;
-  uint new_clustered = 0;
-  // apply preprocessing
-  if(do_preprocessing) do{
-      old_clustered = new_clustered;
-      optimal_clustering = apply_preprocessing(clusterings, optimal_clustering);
-      new_clustered = get_clustered_elements(optimal_clustering).size();
-    } while(old_clustered < new_clustered);
-  // and search with brute force on the remaining instance
-  optimal_clustering = get_consensus_clustering_brute(clusterings, optimal_clustering);
-  return optimal_clustering;
+                                      double* brute_force_percent = NULL,
+                                      const search_method method = SEARCH_BRUTE_FORCE,
+                                      const uint num_threads = 1){
+  const element_dictionary<T> elements = make_element_dictionary(clusterings);
+  return to_clustering(get_consensus_clustering(to_label_clusterings(clusterings, elements),
+                                                do_preprocessing, preprocessing_percent,
+                                                brute_force_percent, method, num_threads), elements);
 }
 
 // the following function is mostly copy-past from
@@ -489,14 +1238,18 @@ vector<clustering<T> > read_clusterings(istream& is){
 }
 
 // write a vector of clusterings to a stream
+// this writes any element type through the maps and is kept for the callers of
+// clustering<T>, clusterings that are given by labels are written from their label
+// arrays by write_label_clusterings (cclust_io.h) in the same format
 template <typename T>
-void write_clusterings(ostream& os, const vector<clustering<T> > clusterings){
+void write_clusterings(ostream& os, const vector<clustering<T> >& clusterings){
   uint num_clusterings = clusterings.size();
-  uint len_clusterings = clusterings[0].size();
+  uint len_clusterings = num_clusterings ? clusterings[0].size() : 0;
 
   os << len_clusterings << " " << num_clusterings << "\n";
-  for(typename clustering<T>::const_iterator i = clusterings[0].begin(); i != clusterings[0].end(); i++)
-    os << i->first << "\n";
+  if(num_clusterings)
+    for(typename clustering<T>::const_iterator i = clusterings[0].begin(); i != clusterings[0].end(); i++)
+      os << i->first << "\n";
   for(uint i = 0; i < num_clusterings; i++)
     os << "clustering" << i << "\n" << clusterings[i] << ".\n";
 }
@@ -511,26 +1264,26 @@ vector<clustering<T> > read_clusterings_from_file(const string& filename){
   return result;
 }
 
-// write a vector of clusterings to a file, return success
+// write a vector of clusterings to a file (through a large buffer, compressed according to its
+// name, see cclust_compress.h), return success
 template <typename T>
-bool write_clusterings_to_file(const string& filename, const vector<clustering<T> > clusterings){
-  ofstream fout;
-  fout.open(filename.c_str());
-  if(fout.good()) {
-    write_clusterings<T>(fout, clusterings);
-    return true;
-  } else return false;
+bool write_clusterings_to_file(const string& filename, const vector<clustering<T> >& clusterings){
+  output_file out(filename);
+  if(!out.good()) return false;
+  ostream& fout = out.stream();
+  write_clusterings<T>(fout, clusterings);
+  return out.close();
 }
 
-// write a clustering to a file, return success
+// write a clustering to a file (through a large buffer, compressed according to its
+// name, see cclust_compress.h), return success
 template <typename T>
-bool write_clustering_to_file(const string& filename, const clustering<T> C){
-  ofstream fout;
-  fout.open(filename.c_str());
-  if(fout.good()) {
-    fout << C;
-    return true;
-  } else return false;
+bool write_clustering_to_file(const string& filename, const clustering<T>& C){
+  output_file out(filename);
+  if(!out.good()) return false;
+  ostream& fout = out.stream();
+  fout << C;
+  return out.close();
 }
 
 // read a vector of clusterings from a file
@@ -552,27 +1305,20 @@ clustering<T> generate_random_clustering(const set<T>& elements, const bool allo
 }
 
 
+// write the clusters of C in the order of their labels, the members of each
+// cluster in the order of the elements
 template <typename T>
 ostream& operator<<(ostream& os, const clustering<T>& C){
-  typename set<T>::const_iterator k;
-  typename map<uint,set<T> >::const_iterator j;
-  map<uint, set<T> > clusters;
-
-  clusters = map<uint, set<T> >();
-  for(typename clustering<T>::const_iterator i = C.begin(); i != C.end(); i++){
-    if(clusters.find(i->second) == clusters.end())
-      clusters.insert(pair<uint,set<T> >(i->second,set<T>()));
-    clusters[i->second].insert(i->first);
-  }
-  j = clusters.begin();
-  while(j != clusters.end()){
-    if(j->first && (!j->second.empty())){
-      k = j->second.begin();
-      os << *(k++);
-      while(k != j->second.end()) os << "," << *(k++);
-      j++;
-      os << ";";
-    } else j++;
+  // the clustered elements, sorted by label and (stable) in the order of C
+  vector<pair<uint, const T*> > members;
+  members.reserve(C.size());
+  for(typename clustering<T>::const_iterator i = C.begin(); i != C.end(); i++)
+    if(i->second) members.push_back(pair<uint, const T*>(i->second, &i->first));
+  stable_sort(members.begin(), members.end(),
+              [](const pair<uint, const T*>& a, const pair<uint, const T*>& b){ return a.first < b.first; });
+  for(typename vector<pair<uint, const T*> >::const_iterator j = members.begin(); j != members.end(); j++){
+    os << *j->second;
+    os << (((j + 1 == members.end()) || ((j + 1)->first != j->first)) ? ";" : ",");
   }
   return os;
 }
@@ -0,0 +1,167 @@
+/* This is cclust_coassoc.h - the co-association matrix of a vector of
+ * clusterings
+ *
+ * for each unordered pair of elements {i,j}, the matrix holds the number
+ * of clusterings that co-cluster i and j. It is computed once per instance
+ * and contains everything the preprocessing, the accumulated distance of a
+ * clustering to all clusterings and the search need to know about the
+ * input. The upper triangle is stored row by row in the smallest integer
+ * type that can hold the number of clusterings. If the program is compiled
+ * with vector instructions, the counts are taken from the element-major
+ * label_matrix (see cclust_label_matrix.h), otherwise from the clusterings
+ *
+ * elements that are known to end up in the same cluster can be merged into
+ * weighted super-elements, then the count of a pair of super-elements is the
+ * sum of the counts of all pairs of their members (stored in 64 bits)
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_coassoc_h
+#define cclust_coassoc_h
+
+#include <stdint.h>
+#include <vector>
+#include "cclust_labels.h"
+#include "cclust_parallel.h"
+#include "cclust_label_matrix.h"
+
+using namespace std;
+
+class coassociation_matrix{
+  uint n;             // number of elements
+  uint m;             // number of clusterings
+  uint width;         // bytes per stored count (1, 2, 4 or 8)
+  vector<uint8_t>  counts8;
+  vector<uint16_t> counts16;
+  vector<uint32_t> counts32;
+  vector<uint64_t> counts64;
+  vector<uint> weights;   // the number of elements in each super-element, empty if all are 1
+
+  // position of the pair {i,j} with i < j in the packed upper triangle
+  inline size_t index(const element_id i, const element_id j) const {
+    return (size_t)i * (2 * (size_t)n - i - 1) / 2 + (j - i - 1);
+  }
+  // position of the first pair {i,i+1} of row i
+  inline size_t row_start(const element_id i) const { return index(i, i + 1); }
+
+  template <typename W>
+  void store_row(vector<W>& counts, const element_id i, const vector<uint32_t>& row){
+    typename vector<W>::iterator out = counts.begin() + row_start(i);
+    for(vector<uint32_t>::const_iterator c = row.begin(); c != row.end(); c++) *(out++) = (W)*c;
+  }
+
+public:
+  coassociation_matrix(): n(0), m(0), width(1) {}
+
+  // count the co-clusterings of all pairs, each distinct clustering is counted
+  // once (with its multiplicity), the rows are distributed over num_threads
+  // threads (0 = one per core)
+  // if the computation is canceled, the result is empty
+  coassociation_matrix(const vector<label_clustering>& clusterings,
+                       const uint num_threads = 0,
+                       const bool* cancel_computation = NULL):
+    coassociation_matrix(weighted_clusterings(clusterings), num_threads, cancel_computation) {}
+
+  coassociation_matrix(const weighted_clusterings& clusterings,
+                       const uint num_threads = 0,
+                       const bool* cancel_computation = NULL):
+    n(clusterings.empty() ? 0 : clusterings.clusterings.begin()->size()), m(clusterings.total())
+  {
+    const size_t num_pairs = ((size_t)n * (n ? n - 1 : 0)) / 2;
+    if(m < 0x100){
+      width = 1;
+      counts8.resize(num_pairs);
+    } else if(m < 0x10000){
+      width = 2;
+      counts16.resize(num_pairs);
+    } else {
+      width = 4;
+      counts32.resize(num_pairs);
+    }
+
+#ifdef LABEL_MATRIX_VECTORIZED
+    const label_matrix matrix(clusterings, num_threads);
+#endif
+    parallel_for(0, n ? n - 1 : 0, [&](const uint i){
+      if(cancel_computation)
+        if(*cancel_computation) return;
+      // count row i in a full width buffer and narrow it afterwards
+      vector<uint32_t> row(n - i - 1, 0);
+#ifdef LABEL_MATRIX_VECTORIZED
+      for(element_id j = i + 1; j < n; j++)
+        row[j - i - 1] = matrix.count(i, j);
+#else
+      for(uint c = 0; c < clusterings.size(); c++){
+        const uint32_t* labels = &clusterings.clusterings[c][0];
+        const uint32_t label_i = labels[i];
+        const uint32_t multiplicity = clusterings.multiplicities[c];
+        for(element_id j = i + 1; j < n; j++)
+          row[j - i - 1] += (labels[j] == label_i) ? multiplicity : 0;
+      }
+#endif
+      switch(width){
+        case 1: store_row(counts8, i, row); break;
+        case 2: store_row(counts16, i, row); break;
+        default: store_row(counts32, i, row); break;
+      }
+    }, num_threads);
+
+    if(cancel_computation)
+      if(*cancel_computation) *this = coassociation_matrix();
+  }
+
+  // the instance in which each group of elements of 'parent' is one super-element,
+  // whose weight is the sum of the weights of its members
+  coassociation_matrix(const coassociation_matrix& parent, const vector<vector<element_id> >& groups):
+    n(groups.size()), m(parent.m), width(8), weights(groups.size(), 0)
+  {
+    counts64.resize(((size_t)n * (n ? n - 1 : 0)) / 2);
+    for(element_id i = 0; i < n; i++)
+      for(vector<element_id>::const_iterator a = groups[i].begin(); a != groups[i].end(); a++)
+        weights[i] += parent.weight(*a);
+    for(element_id i = 0; i < n; i++)
+      for(element_id j = i + 1; j < n; j++){
+        uint64_t& c = counts64[index(i, j)];
+        for(vector<element_id>::const_iterator a = groups[i].begin(); a != groups[i].end(); a++)
+          for(vector<element_id>::const_iterator b = groups[j].begin(); b != groups[j].end(); b++)
+            c += parent.count(*a, *b);
+      }
+  }
+
+  // number of elements
+  uint num_elements() const { return n; }
+  // number of clusterings
+  uint num_clusterings() const { return m; }
+  // a matrix without clusterings carries no information
+  bool empty() const { return m == 0; }
+
+  // the number of elements in the (super-)element i
+  inline uint weight(const element_id i) const { return weights.empty() ? 1 : weights[i]; }
+  // the number of (clustering, pair of members) combinations of i and j,
+  // that is, the distance of a clustering co-clustering i and j plus the
+  // distance of a clustering anti-clustering them on the pairs of members
+  inline uint64_t total(const element_id i, const element_id j) const {
+    return (uint64_t)weight(i) * weight(j) * m;
+  }
+
+  // return the number of clusterings in which i and j are co-clustered
+  // (for super-elements, summed over all pairs of members)
+  inline uint64_t count(const element_id i, const element_id j) const {
+    if(i == j) return total(i, i);
+    const size_t k = (i < j) ? index(i, j) : index(j, i);
+    switch(width){
+      case 1: return counts8[k];
+      case 2: return counts16[k];
+      case 4: return counts32[k];
+      default: return counts64[k];
+    }
+  }
+  // return the number of clusterings in which i and j are anti-clustered
+  // (for super-elements, summed over all pairs of members)
+  inline uint64_t anti_count(const element_id i, const element_id j) const {
+    return total(i, j) - count(i, j);
+  }
+};
+
+#endif
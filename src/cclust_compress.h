@@ -0,0 +1,354 @@
+/* This is cclust_compress.h - transparent compression of the files of clusterings
+ *
+ * compressed input is recognized by its magic number (gzip or zstd), compressed
+ * output by the extension of the file name (.gz or .zst). A decompressing_reader
+ * decompresses on a thread of its own into a short queue of blocks, so the
+ * parser works on one block while the next ones are decompressed. An output_file
+ * is an ostream that compresses what is written to it, or a plain file with a
+ * large buffer. zstd is only available if the program is compiled with HAVE_ZSTD
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_compress_h
+#define cclust_compress_h
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <streambuf>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+// the size of the decompressed blocks and the number of blocks that may wait for the parser
+#define DECOMPRESSION_BLOCK (4 << 20)
+#define DECOMPRESSION_QUEUE 4
+// the size of the buffers of output files
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+// the compression levels of the output
+#define GZIP_LEVEL 6
+#define ZSTD_LEVEL 3
+
+enum compression_method{
+  COMPRESSION_NONE,
+  COMPRESSION_GZIP,
+  COMPRESSION_ZSTD
+};
+
+// return the compression of the data in [begin,end) by its magic number
+inline compression_method get_compression(const char* begin, const char* end){
+  const size_t length = end - begin;
+  if((length >= 2) && !memcmp(begin, "\x1f\x8b", 2)) return COMPRESSION_GZIP;
+  if((length >= 4) && !memcmp(begin, "\x28\xb5\x2f\xfd", 4)) return COMPRESSION_ZSTD;
+  return COMPRESSION_NONE;
+}
+
+// return whether 'filename' ends with 'extension'
+inline bool has_extension(const string& filename, const string& extension){
+  return (filename.size() > extension.size()) &&
+         !filename.compare(filename.size() - extension.size(), extension.size(), extension);
+}
+
+// return the compression of a file to write by the extension of its name
+inline compression_method get_compression(const string& filename){
+  if(has_extension(filename, ".gz")) return COMPRESSION_GZIP;
+  if(has_extension(filename, ".zst")) return COMPRESSION_ZSTD;
+  return COMPRESSION_NONE;
+}
+
+// return 'filename' without the extension of its compression
+inline string strip_compression_extension(const string& filename){
+  switch(get_compression(filename)){
+    case COMPRESSION_GZIP: return filename.substr(0, filename.size() - 3);
+    case COMPRESSION_ZSTD: return filename.substr(0, filename.size() - 4);
+    default: return filename;
+  }
+}
+
+// decompress the data in [begin,end) on a thread of its own into blocks (see above)
+// the data has to stay valid while the reader exists
+class decompressing_reader{
+  const char* begin;
+  const char* end;
+  const compression_method method;
+  deque<string> blocks;
+  bool done;          // all blocks are in the queue
+  bool failed;        // the data is corrupt or the method is not available
+  bool stopped;       // the reader is destroyed, the thread has to stop
+  mutex queue_mutex;
+  condition_variable queue_changed;
+  thread worker;
+
+  // put a block into the queue, waiting while it is full, return whether to continue
+  bool push(string& block){
+    unique_lock<mutex> lock(queue_mutex);
+    while(!stopped && (blocks.size() >= DECOMPRESSION_QUEUE)) queue_changed.wait(lock);
+    if(stopped) return false;
+    blocks.push_back(string());
+    blocks.back().swap(block);
+    queue_changed.notify_all();
+    return true;
+  }
+
+  // decompress gzip (also several concatenated members)
+  bool inflate_all(){
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if(inflateInit2(&z, 15 + 32) != Z_OK) return false;
+    z.next_in = (Bytef*)begin;
+    bool ok = true, finished = false;
+    string block;
+    while(ok && !finished){
+      block.resize(DECOMPRESSION_BLOCK);
+      z.next_out = (Bytef*)&block[0];
+      z.avail_out = block.size();
+      while(z.avail_out && !finished){
+        // zlib counts in 32 bits
+        z.avail_in = (uInt)min((size_t)(end - (const char*)z.next_in), (size_t)1 << 30);
+        const int r = inflate(&z, Z_NO_FLUSH);
+        if(r == Z_STREAM_END){
+          // another member may follow
+          if((const char*)z.next_in == end) finished = true;
+          else inflateReset(&z);
+        } else if(r != Z_OK){
+          // corrupt, or the input ends within a member
+          ok = false;
+          break;
+        }
+      }
+      block.resize(block.size() - z.avail_out);
+      if(!block.empty() && !push(block)) break;
+    }
+    inflateEnd(&z);
+    return ok;
+  }
+
+#ifdef HAVE_ZSTD
+  // decompress zstd (also several concatenated frames)
+  bool decompress_zstd(){
+    ZSTD_DStream* z = ZSTD_createDStream();
+    if(!z) return false;
+    ZSTD_initDStream(z);
+    ZSTD_inBuffer in = {begin, (size_t)(end - begin), 0};
+    bool ok = true, finished = false;
+    size_t pending = 0;     // 0 at the end of a frame
+    string block;
+    while(ok && !finished){
+      block.resize(DECOMPRESSION_BLOCK);
+      ZSTD_outBuffer out = {&block[0], block.size(), 0};
+      while(out.pos < out.size){
+        pending = ZSTD_decompressStream(z, &out, &in);
+        if(ZSTD_isError(pending)){
+          ok = false;
+          break;
+        }
+        // if the output is not full, everything is flushed
+        if((in.pos == in.size) && (out.pos < out.size)){
+          finished = true;
+          break;
+        }
+      }
+      block.resize(out.pos);
+      if(!block.empty() && !push(block)) break;
+    }
+    ZSTD_freeDStream(z);
+    // the last frame has to be complete
+    return ok && !pending;
+  }
+#endif
+
+  void run(){
+    bool ok = false;
+    switch(method){
+      case COMPRESSION_GZIP: ok = inflate_all(); break;
+#ifdef HAVE_ZSTD
+      case COMPRESSION_ZSTD: ok = decompress_zstd(); break;
+#endif
+      default: break;
+    }
+    lock_guard<mutex> lock(queue_mutex);
+    failed = !ok;
+    done = true;
+    queue_changed.notify_all();
+  }
+
+public:
+  decompressing_reader(const char* _begin, const char* _end, const compression_method _method):
+    begin(_begin), end(_end), method(_method), done(false), failed(false), stopped(false),
+    worker(&decompressing_reader::run, this) {}
+  ~decompressing_reader(){
+    {
+      lock_guard<mutex> lock(queue_mutex);
+      stopped = true;
+      queue_changed.notify_all();
+    }
+    worker.join();
+  }
+  decompressing_reader(const decompressing_reader&) = delete;
+  decompressing_reader& operator=(const decompressing_reader&) = delete;
+
+  // move the next block into 'block', return false if there is none
+  bool next(string& block){
+    unique_lock<mutex> lock(queue_mutex);
+    while(blocks.empty() && !done) queue_changed.wait(lock);
+    if(blocks.empty()) return false;
+    block.swap(blocks.front());
+    blocks.pop_front();
+    queue_changed.notify_all();
+    return true;
+  }
+  // whether the data could be decompressed (once next() returned false)
+  bool good(){
+    lock_guard<mutex> lock(queue_mutex);
+    return !failed;
+  }
+};
+
+// a stream buffer that compresses its output into a file
+class compressing_streambuf: public streambuf{
+  FILE* file;
+  const compression_method method;
+  vector<char> input;
+  vector<char> output;
+  bool ok;
+  z_stream z;
+#ifdef HAVE_ZSTD
+  ZSTD_CStream* zstd;
+#endif
+
+  // compress the put area, finishing the stream if 'last' is set
+  bool compress(const bool last){
+    const size_t length = pptr() - pbase();
+    if(method == COMPRESSION_GZIP){
+      z.next_in = (Bytef*)pbase();
+      z.avail_in = length;
+      int r;
+      do{
+        z.next_out = (Bytef*)&output[0];
+        z.avail_out = output.size();
+        r = deflate(&z, last ? Z_FINISH : Z_NO_FLUSH);
+        if(r == Z_STREAM_ERROR) return false;
+        const size_t produced = output.size() - z.avail_out;
+        if(produced && (fwrite(&output[0], 1, produced, file) != produced)) return false;
+      } while(last ? (r != Z_STREAM_END) : (z.avail_in || !z.avail_out));
+    }
+#ifdef HAVE_ZSTD
+    if(method == COMPRESSION_ZSTD){
+      ZSTD_inBuffer in = {pbase(), length, 0};
+      size_t remaining;
+      do{
+        ZSTD_outBuffer out = {&output[0], output.size(), 0};
+        remaining = (in.pos < in.size) ? ZSTD_compressStream(zstd, &out, &in)
+                                       : (last ? ZSTD_endStream(zstd, &out) : 0);
+        if(ZSTD_isError(remaining)) return false;
+        if(out.pos && (fwrite(&output[0], 1, out.pos, file) != out.pos)) return false;
+      } while((in.pos < in.size) || (last && remaining));
+    }
+#endif
+    setp(&input[0], &input[0] + input.size());
+    return true;
+  }
+
+protected:
+  virtual int_type overflow(int_type c){
+    if(!ok || !(ok = compress(false))) return traits_type::eof();
+    if(!traits_type::eq_int_type(c, traits_type::eof())){
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+public:
+  compressing_streambuf(const string& filename, const compression_method _method):
+    file(NULL), method(_method), input(OUTPUT_BUFFER_SIZE), output(OUTPUT_BUFFER_SIZE), ok(false)
+  {
+    memset(&z, 0, sizeof(z));
+    setp(&input[0], &input[0] + input.size());
+#ifdef HAVE_ZSTD
+    zstd = NULL;
+#else
+    if(method == COMPRESSION_ZSTD) return;
+#endif
+    if(!(file = fopen(filename.c_str(), "wb"))) return;
+    if(method == COMPRESSION_GZIP)
+      ok = (deflateInit2(&z, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+#ifdef HAVE_ZSTD
+    if(method == COMPRESSION_ZSTD){
+      zstd = ZSTD_createCStream();
+      ok = zstd && !ZSTD_isError(ZSTD_initCStream(zstd, ZSTD_LEVEL));
+    }
+#endif
+  }
+  ~compressing_streambuf(){ finish(); }
+
+  // compress the rest, finish the stream and close the file, return success
+  bool finish(){
+    if(!file) return false;
+    ok = ok && compress(true);
+    if(method == COMPRESSION_GZIP) deflateEnd(&z);
+#ifdef HAVE_ZSTD
+    if(zstd) ZSTD_freeCStream(zstd);
+    zstd = NULL;
+#endif
+    ok = (fclose(file) == 0) && ok;
+    file = NULL;
+    return ok;
+  }
+  bool good() const { return ok; }
+};
+
+// a file for writing, compressed according to the extension of its name (see above)
+class output_file{
+  vector<char> buffer;
+  filebuf plain;
+  compressing_streambuf* compressed;
+  ostream os;
+  bool opened;
+
+public:
+  explicit output_file(const string& filename): compressed(NULL), os(NULL), opened(false) {
+    const compression_method method = get_compression(filename);
+    if(method == COMPRESSION_NONE){
+      buffer.resize(OUTPUT_BUFFER_SIZE);
+      plain.pubsetbuf(&buffer[0], buffer.size());
+      opened = plain.open(filename.c_str(), ios::out | ios::binary | ios::trunc) != NULL;
+      if(opened) os.rdbuf(&plain);
+    } else {
+      compressed = new compressing_streambuf(filename, method);
+      opened = compressed->good();
+      if(opened) os.rdbuf(compressed);
+    }
+  }
+  ~output_file(){
+    close();
+    delete compressed;
+  }
+  output_file(const output_file&) = delete;
+  output_file& operator=(const output_file&) = delete;
+
+  bool good() const { return opened && os.good(); }
+  ostream& stream(){ return os; }
+
+  // flush and close the file, return whether everything was written
+  bool close(){
+    if(!opened) return false;
+    bool ok = os.flush().good();
+    if(compressed) ok = compressed->finish() && ok;
+    else ok = (plain.close() != NULL) && ok;
+    opened = false;
+    return ok;
+  }
+};
+
+#endif
@@ -0,0 +1,311 @@
+/* This is cclust_fpt.h - the search tree algorithm parameterized by the
+ * average distance of the clusterings
+ *
+ * as shown in "Average Parameterization and Partial Kernelization for
+ * Computing Medians" (Betzler, Guo, Komusiewicz, Niedermeier), the consensus of
+ * clusterings whose average distance is d costs at most d, and since any
+ * clustering pays at least m/3 on each dirty pair, there are at most 3d/m dirty
+ * pairs and at most d/min-excess pairs on which the consensus can go against
+ * the majority. So instead of enumerating clusterings, the search starts with
+ * the graph of the pairs that the majority co-clusters and resolves its
+ * conflict triples {u,v,w} (u is co-clustered with v and w, but v is not with w)
+ * by branching into (1) separating u and v, (2) separating u and w, keeping u
+ * and v together, and (3) joining v and w, keeping the other two pairs. Each
+ * branch decides a pair for good and pays its excess, so the depth of the tree
+ * is bounded by the budget (the cost that the consensus may exceed the sum of
+ * the pair bounds by), which is derived from the average distance.
+ * A subtree is skipped if a packing of pair-disjoint conflict triples shows
+ * that it cannot stay within the budget
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_fpt_h
+#define cclust_fpt_h
+
+#include <vector>
+#include <stdint.h>
+#include "cclust_labels.h"
+#include "cclust_coassoc.h"
+#include "cclust_search.h"
+
+using namespace std;
+
+// the decisions of the search on a pair
+#define PAIR_UNDECIDED 0
+#define PAIR_PERMANENT 1    // the pair is co-clustered for good
+#define PAIR_FORBIDDEN 2    // the pair is separated for good
+
+// the state of the search tree algorithm
+class fpt_state{
+public:
+  const coassociation_matrix* coassoc;
+  uint n;
+  uint words;                     // 64 bit words per row of 'present'
+  vector<uint64_t> present;       // bit y of row x: x and y are co-clustered in the current graph
+  vector<uint8_t> decided;        // the decision on each pair (see above)
+  vector<uint64_t> packed;        // buffer for the pairs used by the packing, as 'present'
+
+  uint64_t bound;                 // only excesses up to the bound are searched
+  uint64_t best_excess;           // (uint64_t)-1 if no clustering was found yet
+  label_clustering best;
+  label_clustering fixed;         // the labels of the clustered elements of the start
+
+  uint64_t searched;              // the share of the tree searched or skipped so far
+  double* progress_pc;
+  const bool* cancel_computation;
+
+  bool is_present(const element_id x, const element_id y) const {
+    return (present[(size_t)x * words + (y >> 6)] >> (y & 63)) & 1;
+  }
+  void set_present(const element_id x, const element_id y, const bool value){
+    const uint64_t bit_y = 1ULL << (y & 63), bit_x = 1ULL << (x & 63);
+    uint64_t& word_x = present[(size_t)x * words + (y >> 6)];
+    uint64_t& word_y = present[(size_t)y * words + (x >> 6)];
+    if(value){ word_x |= bit_y; word_y |= bit_x; } else { word_x &= ~bit_y; word_y &= ~bit_x; }
+  }
+  uint8_t& decision(const element_id x, const element_id y){ return decided[(size_t)x * n + y]; }
+  void decide(const element_id x, const element_id y, const uint8_t d){ decision(x, y) = decision(y, x) = d; }
+};
+
+// account for a searched or skipped subtree
+inline void add_progress(fpt_state& S, const double share){
+  S.searched += (uint64_t)(share * PROGRESS_UNITS);
+  if(S.progress_pc) *S.progress_pc = S.searched / PROGRESS_UNITS;
+}
+
+// find a conflict triple in the current graph: u is co-clustered with v and w,
+// but v is not with w. If the neighborhoods of two adjacent elements differ,
+// any element in the difference completes a conflict triple with them
+inline bool find_conflict_triple(const fpt_state& S, element_id& u, element_id& v, element_id& w){
+  for(element_id x = 0; x < S.n; x++){
+    const uint64_t* row_x = &S.present[(size_t)x * S.words];
+    for(uint k = 0; k < S.words; k++)
+      for(uint64_t word = row_x[k]; word; word &= word - 1){
+        const element_id y = (k << 6) + __builtin_ctzll(word);
+        if(y < x) continue;
+        const uint64_t* row_y = &S.present[(size_t)y * S.words];
+        for(uint l = 0; l < S.words; l++){
+          uint64_t diff = row_x[l] ^ row_y[l];
+          // x and y are in each other's rows, but they are not what we are looking for
+          if(l == (x >> 6)) diff &= ~(1ULL << (x & 63));
+          if(l == (y >> 6)) diff &= ~(1ULL << (y & 63));
+          if(diff){
+            w = (l << 6) + __builtin_ctzll(diff);
+            if(S.is_present(x, w)){ u = x; v = y; } else { u = y; v = x; }
+            return true;
+          }
+        }
+      }
+  }
+  return false;
+}
+
+// pack pair-disjoint conflict triples of the current graph greedily and return
+// the least excess the current graph still has to pay on them, that is, for
+// each triple, the least excess of its undecided pairs ((uint64_t)-1 if some
+// triple cannot be resolved anymore)
+inline uint64_t get_packing_bound(fpt_state& S){
+  const coassociation_matrix& coassoc = *S.coassoc;
+  fill(S.packed.begin(), S.packed.end(), 0);
+  uint64_t bound = 0;
+  for(element_id u = 0; u < S.n; u++){
+    const uint64_t* row_u = &S.present[(size_t)u * S.words];
+    uint64_t* used_u = &S.packed[(size_t)u * S.words];
+    for(uint k = 0; k < S.words; k++)
+      for(uint64_t word = row_u[k] & ~used_u[k]; word; word &= word - 1){
+        const element_id v = (k << 6) + __builtin_ctzll(word);
+        // uv may have been used by a triple of u found meanwhile
+        if((used_u[k] >> (v & 63)) & 1) continue;
+        const uint64_t* row_v = &S.present[(size_t)v * S.words];
+        uint64_t* used_v = &S.packed[(size_t)v * S.words];
+        // w is adjacent to u but not to v, and the pairs uw and vw are unused
+        for(uint l = 0; l < S.words; l++){
+          uint64_t candidates = row_u[l] & ~row_v[l] & ~used_u[l] & ~used_v[l];
+          if(l == (v >> 6)) candidates &= ~(1ULL << (v & 63));
+          if(!candidates) continue;
+          const element_id w = (l << 6) + __builtin_ctzll(candidates);
+          uint64_t least = (uint64_t)-1;
+          if(S.decision(u, v) == PAIR_UNDECIDED) least = min(least, get_pair_excess(coassoc, u, v));
+          if(S.decision(u, w) == PAIR_UNDECIDED) least = min(least, get_pair_excess(coassoc, u, w));
+          if(S.decision(v, w) == PAIR_UNDECIDED) least = min(least, get_pair_excess(coassoc, v, w));
+          if(least == (uint64_t)-1) return least;
+          bound += least;
+          used_u[v >> 6] |= 1ULL << (v & 63);
+          used_u[w >> 6] |= 1ULL << (w & 63);
+          used_v[w >> 6] |= 1ULL << (w & 63);
+          S.packed[(size_t)v * S.words + (u >> 6)] |= 1ULL << (u & 63);
+          S.packed[(size_t)w * S.words + (u >> 6)] |= 1ULL << (u & 63);
+          S.packed[(size_t)w * S.words + (v >> 6)] |= 1ULL << (v & 63);
+          break;
+        }
+      }
+  }
+  return bound;
+}
+
+// the current graph is a disjoint union of cliques, label them
+// the cliques containing clustered elements of the start keep their labels
+inline label_clustering get_clique_labels(const fpt_state& S){
+  label_clustering C(S.fixed);
+  uint32_t next_label = 1;
+  for(element_id x = 0; x < S.n; x++) next_label = max(next_label, S.fixed[x] + 1);
+  for(element_id x = 0; x < S.n; x++) if(S.fixed[x])
+    for(element_id y = 0; y < S.n; y++)
+      if(S.is_present(x, y)) C[y] = S.fixed[x];
+  for(element_id x = 0; x < S.n; x++) if(!C[x]){
+    for(element_id y = x + 1; y < S.n; y++)
+      if(S.is_present(x, y)) C[y] = next_label;
+    C[x] = next_label++;
+  }
+  return C;
+}
+
+// one node of the search tree: 'excess' is what the current graph pays on top of
+// the pair bounds, pairs that are not decided follow the majority
+inline void fpt_branch(fpt_state& S, const uint64_t excess, const double share){
+  if(S.cancel_computation)
+    if(*S.cancel_computation) return;
+  element_id u, v, w;
+  const uint64_t packing_bound = get_packing_bound(S);
+  if((packing_bound == (uint64_t)-1) || (excess + packing_bound > S.bound)){
+    add_progress(S, share);
+    return;
+  }
+  if(!find_conflict_triple(S, u, v, w)){
+    if(excess < S.best_excess){
+      S.best_excess = excess;
+      S.best = get_clique_labels(S);
+      // from now on, only better clusterings are searched
+      S.bound = excess ? min(S.bound, excess - 1) : 0;
+    }
+    add_progress(S, share);
+    return;
+  }
+  const coassociation_matrix& coassoc = *S.coassoc;
+  const double step = share / 3;
+  const uint8_t d_uv = S.decision(u, v), d_uw = S.decision(u, w), d_vw = S.decision(v, w);
+
+  // (1) separate u and v
+  const uint64_t cost_uv = get_pair_excess(coassoc, u, v);
+  if((d_uv == PAIR_UNDECIDED) && (excess + cost_uv <= S.bound)){
+    S.decide(u, v, PAIR_FORBIDDEN);
+    S.set_present(u, v, false);
+    fpt_branch(S, excess + cost_uv, step);
+    S.set_present(u, v, true);
+    S.decide(u, v, PAIR_UNDECIDED);
+  } else add_progress(S, step);
+
+  // (2) separate u and w, but keep u and v together
+  const uint64_t cost_uw = get_pair_excess(coassoc, u, w);
+  if((d_uw == PAIR_UNDECIDED) && (excess + cost_uw <= S.bound)){
+    S.decide(u, w, PAIR_FORBIDDEN);
+    S.decide(u, v, PAIR_PERMANENT);
+    S.set_present(u, w, false);
+    fpt_branch(S, excess + cost_uw, step);
+    S.set_present(u, w, true);
+    S.decide(u, v, d_uv);
+    S.decide(u, w, PAIR_UNDECIDED);
+  } else add_progress(S, step);
+
+  // (3) join v and w, keeping u with both
+  const uint64_t cost_vw = get_pair_excess(coassoc, v, w);
+  if((d_vw == PAIR_UNDECIDED) && (excess + cost_vw <= S.bound)){
+    S.decide(v, w, PAIR_PERMANENT);
+    S.decide(u, v, PAIR_PERMANENT);
+    S.decide(u, w, PAIR_PERMANENT);
+    S.set_present(v, w, true);
+    fpt_branch(S, excess + cost_vw, step);
+    S.set_present(v, w, false);
+    S.decide(u, w, d_uw);
+    S.decide(u, v, d_uv);
+    S.decide(v, w, PAIR_UNDECIDED);
+  } else add_progress(S, step);
+}
+
+// complete the given (partial) clustering to a clustering of minimum accumulated
+// distance to all clusterings in coassoc by the search tree algorithm (see above)
+// the search is limited to clusterings whose accumulated distance is at most
+// 'budget', which should be the average distance of the clusterings (or any other
+// upper bound on the optimum, see get_avg_distance). If the budget is too small,
+// the search is repeated with the cost of the heuristic clustering as budget,
+// so the result is optimal in any case
+// the elements clustered in current_clustering stay in their clusters, but other
+// elements may join them
+inline label_clustering get_consensus_clustering_fpt(const coassociation_matrix& coassoc,
+                                                     label_clustering current_clustering = label_clustering(),
+                                                     const uint64_t budget = (uint64_t)-1,
+                                                     double* progress_pc = NULL,
+                                                     const bool* cancel_computation = NULL){
+  if(cancel_computation)
+    if(*cancel_computation) return label_clustering();
+  // if the current_clustering is new, set all items to unclustered
+  if(current_clustering.empty()){
+    if(!coassoc.empty())
+      current_clustering = label_clustering(coassoc.num_elements());
+    else return current_clustering;
+  }
+
+  fpt_state S;
+  S.coassoc = &coassoc;
+  S.n = current_clustering.size();
+  S.words = (S.n + 63) / 64;
+  S.present.assign((size_t)S.n * S.words, 0);
+  S.decided.assign((size_t)S.n * S.n, PAIR_UNDECIDED);
+  S.packed.assign((size_t)S.n * S.words, 0);
+  S.fixed = current_clustering;
+  S.progress_pc = progress_pc;
+  S.cancel_computation = cancel_computation;
+
+  // the start graph follows the majority, except for the clustered elements
+  uint64_t pair_bound = 0, excess = 0;
+  for(element_id x = 0; x < S.n; x++)
+    for(element_id y = x + 1; y < S.n; y++){
+      pair_bound += get_pair_bound(coassoc, x, y);
+      bool coed_xy = pred_coed(coassoc, x, y);
+      if(current_clustering[x] && current_clustering[y]){
+        const bool same = (current_clustering[x] == current_clustering[y]);
+        S.decide(x, y, same ? PAIR_PERMANENT : PAIR_FORBIDDEN);
+        if(same != coed_xy) excess += get_pair_excess(coassoc, x, y);
+        coed_xy = same;
+      }
+      if(coed_xy) S.set_present(x, y, true);
+    }
+
+  // the heuristics give the first clustering
+  S.best = current_clustering;
+  uint64_t best_cost = get_greedy_completion(coassoc, S.best);
+  {
+    const label_clustering seed = get_consensus_clustering_heuristic(coassoc, current_clustering,
+        HEURISTIC_LOCAL_SEARCH, SEED_HEURISTIC_RUNS, NULL, cancel_computation, NULL, 1);
+    const uint64_t seed_cost = get_accumulated_distance(coassoc, seed);
+    if(seed_cost < best_cost){
+      S.best = seed;
+      best_cost = seed_cost;
+    }
+  }
+  S.best_excess = best_cost - pair_bound;
+  if(!S.best_excess){
+    if(progress_pc) *progress_pc = 1.0;
+    return S.best;
+  }
+
+  // search for better clusterings within the budget first
+  const uint64_t heuristic_bound = S.best_excess - 1;
+  S.bound = (budget < pair_bound) ? 0 : min(heuristic_bound, budget - pair_bound);
+  bool repeat = (S.bound < heuristic_bound);
+  while(true){
+    S.searched = 0;
+    if(excess <= S.bound) fpt_branch(S, excess, 1);
+    if(cancel_computation)
+      if(*cancel_computation) return label_clustering();
+    // the budget was too small if there is no clustering within it
+    if(!repeat || (S.best_excess <= S.bound + 1)) break;
+    S.bound = heuristic_bound;
+    repeat = false;
+  }
+  if(progress_pc) *progress_pc = 1.0;
+  return S.best;
+}
+
+#endif
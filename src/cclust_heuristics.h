@@ -0,0 +1,250 @@
+/* This is cclust_heuristics.h - fast heuristics for the consensus clustering
+ *
+ * the pivot heuristic (KwikCluster) picks a random unclustered element and
+ * clusters it with all unclustered elements the majority co-clusters it with,
+ * until all elements are clustered. The local search then moves single
+ * elements into the cluster (or a new one) that decreases the accumulated
+ * distance most, as long as there is such a move; for each element, the
+ * counts with the clusters it is co-clustered with are maintained incrementally.
+ * Both are restarted with different random orders on several threads and
+ * the best clustering is kept. Their results are upper bounds for the exact
+ * search and are used to seed its incumbent
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_heuristics_h
+#define cclust_heuristics_h
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <random>
+#include <algorithm>
+#include "cclust_labels.h"
+#include "cclust_coassoc.h"
+#include "cclust_parallel.h"
+
+using namespace std;
+
+// the default number of restarts of the heuristics
+#define HEURISTIC_RESTARTS 64
+// the number of stored sums of counts per run of the local search, above which
+// they are recomputed for each element instead (see improve_by_local_search)
+#ifndef LOCAL_SEARCH_MAX_COUNTS
+#define LOCAL_SEARCH_MAX_COUNTS (1 << 22)
+#endif
+
+// the sums of the counts of an element with the members of each cluster
+typedef unordered_map<uint32_t, uint64_t> cluster_counts;
+
+enum heuristic_method{
+  HEURISTIC_PIVOT,          // restarts of the pivot heuristic
+  HEURISTIC_LOCAL_SEARCH    // restarts of the pivot heuristic, each improved by local search
+};
+
+// return the accumulated distance of the (complete) clustering C
+// to all clusterings counted in coassoc
+inline uint64_t get_accumulated_distance(const coassociation_matrix& coassoc, const label_clustering& C){
+  uint64_t dist = 0;
+  for(element_id i = 0; i < C.size(); i++)
+    for(element_id j = i + 1; j < C.size(); j++)
+      dist += (C[i] == C[j]) ? coassoc.anti_count(i, j) : coassoc.count(i, j);
+  return dist;
+}
+
+// cluster the unclustered elements of C with the pivot heuristic (see above),
+// the elements are picked as pivots in a random order
+template <typename R>
+void cluster_by_pivots(const coassociation_matrix& coassoc, label_clustering& C, R& rng){
+  vector<element_id> order = get_unclustered_elements(C);
+  shuffle(order.begin(), order.end(), rng);
+  uint32_t next_label = 1;
+  for(label_clustering::const_iterator i = C.begin(); i != C.end(); i++)
+    next_label = max(next_label, *i + 1);
+  for(vector<element_id>::const_iterator p = order.begin(); p != order.end(); p++) if(!C[*p]){
+    C[*p] = next_label;
+    for(vector<element_id>::const_iterator x = order.begin(); x != order.end(); x++)
+      if(!C[*x] && (coassoc.count(*p, *x) > coassoc.anti_count(*p, *x)))
+        C[*x] = next_label;
+    next_label++;
+  }
+}
+
+// improve the complete clustering C by moving the elements that are 'movable'
+// (see above) until no move decreases the accumulated distance
+// gain(x,c) is the distance x pays to the members of cluster c when joining it
+// minus the distance it pays to them when staying apart, so moving x from a to
+// b changes the accumulated distance by gain(x,b) - gain(x,a). Since the anti-
+// count of a pair is its total minus its count, gain(x,c) = m w(x) W(c) - 2 N(x,c)
+// where W(c) is the weight of c without x and N(x,c) is the sum of the counts of
+// x with the members of c. N is only stored for the clusters that contain an
+// element co-clustered with x at least once, other clusters have a positive gain
+// and are never better than a new cluster. If N would exceed
+// LOCAL_SEARCH_MAX_COUNTS entries, it is recomputed for each element instead
+inline void improve_by_local_search(const coassociation_matrix& coassoc, label_clustering& C,
+                                    const vector<bool>& movable,
+                                    const bool* cancel_computation = NULL){
+  const uint n = C.size();
+  vector<element_id> moving;
+  for(element_id x = 0; x < n; x++) if(movable[x]) moving.push_back(x);
+  if(moving.empty()) return;
+
+  // relabel the clusters to 1...k, the labels above are free for new clusters
+  label_clustering labels(n);
+  map<uint32_t, uint32_t> new_labels;
+  for(element_id x = 0; x < n; x++){
+    map<uint32_t, uint32_t>::const_iterator l = new_labels.find(C[x]);
+    if(l == new_labels.end())
+      l = new_labels.insert(pair<uint32_t, uint32_t>(C[x], new_labels.size() + 1)).first;
+    labels[x] = l->second;
+  }
+  const uint slots = new_labels.size() + moving.size() + 1;
+  vector<uint> cluster_size(slots, 0);
+  vector<uint64_t> cluster_weight(slots, 0);
+  for(element_id x = 0; x < n; x++){
+    cluster_size[labels[x]]++;
+    cluster_weight[labels[x]] += coassoc.weight(x);
+  }
+  vector<uint32_t> free_labels;
+  for(uint32_t c = slots - 1; c > 0; c--) if(!cluster_size[c]) free_labels.push_back(c);
+
+  // N of each movable element (see above), unless it is recomputed
+  vector<cluster_counts> counts(moving.size());
+  size_t num_counts = 0;
+  bool on_demand = false;
+  for(uint r = 0; (r < moving.size()) && !on_demand; r++){
+    for(element_id y = 0; y < n; y++) if(y != moving[r]){
+      const uint64_t c = coassoc.count(moving[r], y);
+      if(c) counts[r][labels[y]] += c;
+    }
+    num_counts += counts[r].size();
+    on_demand = (num_counts > LOCAL_SEARCH_MAX_COUNTS);
+  }
+  if(on_demand) vector<cluster_counts>().swap(counts);
+  cluster_counts row;
+
+  const uint64_t m = coassoc.num_clusterings();
+  bool improved = true;
+  while(improved){
+    improved = false;
+    for(uint r = 0; r < moving.size(); r++){
+      if(cancel_computation)
+        if(*cancel_computation) return;
+      const element_id x = moving[r];
+      const uint64_t wx = coassoc.weight(x);
+      if(on_demand){
+        row.clear();
+        for(element_id y = 0; y < n; y++) if(y != x){
+          const uint64_t c = coassoc.count(x, y);
+          if(c) row[labels[y]] += c;
+        }
+      }
+      const cluster_counts& N = on_demand ? row : counts[r];
+      const uint32_t from = labels[x];
+      const cluster_counts::const_iterator N_from = N.find(from);
+      int64_t best = (int64_t)(m * wx * (cluster_weight[from] - wx)) -
+                     2 * (int64_t)((N_from == N.end()) ? 0 : N_from->second);
+      // find the best cluster for x, of equally good ones the smallest label,
+      // a new cluster has gain 0
+      uint32_t to = from;
+      int64_t best_other = INT64_MAX;
+      uint32_t other = 0;
+      for(cluster_counts::const_iterator c = N.begin(); c != N.end(); c++) if(c->first != from){
+        const int64_t g = (int64_t)(m * wx * cluster_weight[c->first]) - 2 * (int64_t)c->second;
+        if((g < best_other) || ((g == best_other) && (c->first < other))){ best_other = g; other = c->first; }
+      }
+      if(best_other < best){ best = best_other; to = other; }
+      // (if x is not alone, there is a free label, see the number of slots)
+      if((cluster_size[from] > 1) && (best > 0)){ best = 0; to = free_labels.back(); }
+      if(to == from) continue;
+
+      // move x and update N of the other movable elements
+      if(!cluster_size[to]) free_labels.pop_back();
+      labels[x] = to;
+      cluster_size[from]--;
+      cluster_size[to]++;
+      cluster_weight[from] -= wx;
+      cluster_weight[to] += wx;
+      if(!cluster_size[from]) free_labels.push_back(from);
+      if(!on_demand){
+        for(uint s = 0; s < moving.size(); s++) if(s != r){
+          const uint64_t c = coassoc.count(moving[s], x);
+          if(!c) continue;
+          cluster_counts& N_s = counts[s];
+          const cluster_counts::iterator f = N_s.find(from);
+          if(!(f->second -= c)){
+            N_s.erase(f);
+            num_counts--;
+          }
+          const pair<cluster_counts::iterator, bool> t = N_s.insert(pair<uint32_t, uint64_t>(to, 0));
+          t.first->second += c;
+          if(t.second) num_counts++;
+        }
+        if(num_counts > LOCAL_SEARCH_MAX_COUNTS){
+          on_demand = true;
+          vector<cluster_counts>().swap(counts);
+        }
+      }
+      improved = true;
+    }
+  }
+  C = labels;
+}
+
+// compute a good (not necessarily optimal) completion of current_clustering
+// by 'restarts' runs of the given heuristic (see above), distributed over
+// num_threads threads (0 = one per core); the elements clustered in
+// current_clustering stay in their clusters, but other elements may join them
+// whenever a better clustering is found, its accumulated distance is written to
+// best_cost; the progress and best_cost are atomic, so other threads may read them
+// meanwhile. If the computation is canceled, the best clustering so far is returned
+inline label_clustering get_consensus_clustering_heuristic(const coassociation_matrix& coassoc,
+                                            label_clustering current_clustering = label_clustering(),
+                                            const heuristic_method method = HEURISTIC_LOCAL_SEARCH,
+                                            const uint restarts = HEURISTIC_RESTARTS,
+                                            atomic<double>* progress_pc = NULL,
+                                            const bool* cancel_computation = NULL,
+                                            atomic<uint64_t>* best_cost = NULL,
+                                            const uint num_threads = 0){
+  // if the current_clustering is new, set all items to unclustered
+  if(current_clustering.empty()){
+    if(!coassoc.empty())
+      current_clustering = label_clustering(coassoc.num_elements());
+    else return current_clustering;
+  }
+  vector<bool> movable(current_clustering.size());
+  for(element_id x = 0; x < current_clustering.size(); x++) movable[x] = !current_clustering[x];
+
+  label_clustering best;
+  uint64_t best_distance = (uint64_t)-1;
+  uint best_run = 0;
+  mutex best_mutex;
+  atomic<uint> runs_done(0);
+  parallel_for(0, restarts, [&](const uint run){
+    if(cancel_computation)
+      if(*cancel_computation) return;
+    // each run has its own random order, so the result does not depend on the threads
+    mt19937 rng(run);
+    label_clustering C = current_clustering;
+    cluster_by_pivots(coassoc, C, rng);
+    if(method == HEURISTIC_LOCAL_SEARCH)
+      improve_by_local_search(coassoc, C, movable, cancel_computation);
+    const uint64_t distance = get_accumulated_distance(coassoc, C);
+    {
+      lock_guard<mutex> lock(best_mutex);
+      // of equally good clusterings, keep the one of the first run
+      if((distance < best_distance) || ((distance == best_distance) && (run < best_run))){
+        best_distance = distance;
+        best_run = run;
+        best = C;
+        if(best_cost) *best_cost = distance;
+      }
+      if(progress_pc) *progress_pc = (double)(++runs_done) / restarts;
+    }
+  }, num_threads);
+  if(best.empty()) return current_clustering;
+  return best;
+}
+
+#endif
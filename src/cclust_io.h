@@ -0,0 +1,714 @@
+/* This is cclust_io.h - fast input and output of clusterings
+ *
+ * the text format of write_clusterings (cclust.h) is
+ *   <number of elements> <number of clusterings>
+ *   <one element name per line>
+ *   clustering0
+ *   a,b,c;d,e;.
+ *   clustering1
+ *   ...
+ * a file is mapped into memory and parsed in place: the names are looked up
+ * as name_views into the mapped file, so no token is copied, and each clustering
+ * is written into its label_clustering right away. The records of the
+ * clusterings are parsed on several threads
+ *
+ * the binary format stores an instance as it is used:
+ *   a binary_header (magic, version, label width, n, m, size of the names)
+ *   n + 1 offsets (uint64_t) of the names into the characters that follow
+ *   the characters of the names
+ *   the m x n labels, clustering by clustering, in uint8_t, uint16_t or uint32_t
+ * each section starts at a multiple of 8 bytes, so a mapped file is used in
+ * place by binary_clusterings. The integers are in the byte order of the
+ * machine, a file of the other byte order fails the version check
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_io_h
+#define cclust_io_h
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cclust_labels.h"
+#include "cclust_parallel.h"
+#include "cclust_compress.h"
+
+using namespace std;
+
+// a file mapped into memory for reading, if it cannot be mapped (for example,
+// if it is empty or not a regular file), it is read into a buffer instead
+class mapped_file{
+  const char* data;
+  size_t length;
+  bool mapped;
+  bool opened;
+  vector<char> buffer;
+
+public:
+  explicit mapped_file(const string& filename): data(NULL), length(0), mapped(false), opened(false) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if(fd < 0) return;
+    opened = true;
+    struct stat info;
+    if((fstat(fd, &info) == 0) && S_ISREG(info.st_mode) && (info.st_size > 0)){
+      void* p = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(p != MAP_FAILED){
+        madvise(p, info.st_size, MADV_SEQUENTIAL);
+        data = (const char*)p;
+        length = info.st_size;
+        mapped = true;
+      }
+    }
+    if(!mapped){
+      char chunk[1 << 16];
+      ssize_t r;
+      while((r = read(fd, chunk, sizeof(chunk))) > 0) buffer.insert(buffer.end(), chunk, chunk + r);
+      if(r < 0) opened = false;
+      data = buffer.empty() ? NULL : &buffer[0];
+      length = buffer.size();
+    }
+    close(fd);
+  }
+  ~mapped_file(){
+    if(mapped) munmap((void*)data, length);
+  }
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  bool good() const { return opened; }
+  const char* begin() const { return data; }
+  const char* end() const { return data + length; }
+  size_t size() const { return length; }
+};
+
+// a name in the input, without a copy of its characters
+struct name_view{
+  const char* data;
+  size_t length;
+
+  name_view(const char* _data = NULL, const size_t _length = 0): data(_data), length(_length) {}
+  bool operator==(const name_view& other) const {
+    return (length == other.length) && !memcmp(data, other.data, length);
+  }
+  // the order of strings
+  bool operator<(const name_view& other) const {
+    const int c = memcmp(data, other.data, min(length, other.length));
+    return c ? (c < 0) : (length < other.length);
+  }
+  string to_string() const { return string(data, length); }
+};
+
+// FNV-1a hash of the characters of a name
+struct name_view_hash{
+  size_t operator()(const name_view& name) const {
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i = 0; i < name.length; i++){
+      h ^= (unsigned char)name.data[i];
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+};
+
+// return the rest of the line at p (without the line break, which may be
+// "\r\n") and move p to the next line
+inline name_view next_line(const char*& p, const char* end){
+  const char* start = p;
+  const char* eol = (const char*)memchr(p, '\n', end - p);
+  if(!eol) eol = end;
+  p = (eol == end) ? end : eol + 1;
+  if((eol != start) && (*(eol - 1) == '\r')) eol--;
+  return name_view(start, eol - start);
+}
+
+// read the next unsigned number at p, skipping white space before it
+inline bool next_number(const char*& p, const char* end, uint& number){
+  while((p != end) && ((*p == ' ') || (*p == '\t') || (*p == '\n') || (*p == '\r'))) p++;
+  if((p == end) || (*p < '0') || (*p > '9')) return false;
+  number = 0;
+  while((p != end) && (*p >= '0') && (*p <= '9')) number = 10 * number + (*(p++) - '0');
+  return true;
+}
+
+// the names of the elements and their positions in the name table
+typedef unordered_map<name_view, element_id, name_view_hash> name_table;
+
+// the size of the chunks in which the records are searched
+#define RECORD_SCAN_CHUNK (1 << 20)
+
+// return the end of the header at begin (the line of the numbers and the name
+// table), or NULL if it is invalid or if it is incomplete, unless 'last' is set
+// (then the input ends at 'end')
+inline const char* find_header_end(const char* begin, const char* end, const bool last){
+  const char* p = begin;
+  uint num_names, num_clusterings;
+  if(!next_number(p, end, num_names) || !next_number(p, end, num_clusterings)) return NULL;
+  // the rest of the line of the numbers and the lines of the names
+  for(uint i = 0; i <= num_names; i++){
+    const char* eol = (const char*)memchr(p, '\n', end - p);
+    if(!eol) return last ? end : NULL;
+    p = eol + 1;
+  }
+  return p;
+}
+
+// read the (complete) header in [begin,end) into the name table, the names
+// point into the header; return whether the numbers could be read
+inline bool parse_header(const char* begin, const char* end, uint& num_clusterings,
+                         name_table& table, vector<name_view>& names){
+  const char* p = begin;
+  uint num_names;
+  if(!next_number(p, end, num_names) || !next_number(p, end, num_clusterings)) return false;
+  next_line(p, end);
+  table.reserve(num_names);
+  for(uint i = 0; (i < num_names) && (p != end); i++){
+    const name_view name = next_line(p, end);
+    if(table.insert(pair<name_view, element_id>(name, names.size())).second) names.push_back(name);
+  }
+  return true;
+}
+
+// return the positions of the '.' that end the records in [begin,end), in order
+// the chunks of the input are scanned on num_threads threads (0 = one per core)
+inline vector<const char*> find_record_ends(const char* begin, const char* end, const uint num_threads = 0){
+  const size_t num_chunks = (end - begin + RECORD_SCAN_CHUNK - 1) / RECORD_SCAN_CHUNK;
+  vector<vector<const char*> > chunk_ends(num_chunks);
+  parallel_for(0, num_chunks, [&](const uint c){
+    const char* p = begin + (size_t)c * RECORD_SCAN_CHUNK;
+    const char* chunk_end = min(end, p + RECORD_SCAN_CHUNK);
+    while((p = (const char*)memchr(p, '.', chunk_end - p)) != NULL) chunk_ends[c].push_back(p++);
+  }, num_threads);
+  vector<const char*> ends;
+  for(size_t c = 0; c < num_chunks; c++) ends.insert(ends.end(), chunk_ends[c].begin(), chunk_ends[c].end());
+  return ends;
+}
+
+// read the record of a clustering in [p,dot) into C (see parse_clusterings),
+// return whether all of its elements are in the name table
+inline bool parse_clustering_record(const char* p, const char* dot, const name_table& table, label_clustering& C){
+  // skip the name of the clustering
+  next_line(p, dot);
+  uint32_t label = 1;
+  bool cluster_empty = true;
+  while(true){
+    const char* start = p;
+    while((p != dot) && (*p != ',') && (*p != ';')) p++;
+    if(p != start){
+      const name_table::const_iterator x = table.find(name_view(start, p - start));
+      if(x == table.end()) return false;
+      C[x->second] = label;
+      cluster_empty = false;
+    }
+    if(p == dot) return true;
+    if((*(p++) == ';') && !cluster_empty){
+      label++;
+      cluster_empty = true;
+    }
+  }
+}
+
+// read the records in [begin,end), which starts with a record, on num_threads
+// threads (0 = one per core) and append them to 'clusterings' (of n elements),
+// up to num_clusterings in total; unless 'last' is set (then the input ends at
+// 'end'), a record whose line is incomplete is left for later
+// return the end of the records that were read, or NULL if a record contains
+// an element that is not in the name table
+inline const char* parse_records(const char* begin, const char* end, const bool last,
+                                 const name_table& table, const uint n, const uint num_clusterings,
+                                 vector<label_clustering>& clusterings, const uint num_threads = 0){
+  vector<const char*> ends = find_record_ends(begin, end, num_threads);
+  if(!last && !ends.empty() && !memchr(ends.back(), '\n', end - ends.back())) ends.pop_back();
+  const uint first = clusterings.size();
+  if(ends.size() > num_clusterings - first) ends.resize(num_clusterings - first);
+  if(ends.empty()) return begin;
+  // the records start at begin and after the line of each '.'
+  vector<const char*> starts(ends.size(), begin);
+  for(uint i = 1; i < ends.size(); i++){
+    const char* q = ends[i - 1];
+    next_line(q, end);
+    starts[i] = q;
+  }
+  clusterings.resize(first + ends.size());
+  vector<char> valid(ends.size(), true);
+  parallel_for(0, ends.size(), [&](const uint i){
+    clusterings[first + i] = label_clustering(n);
+    if(starts[i] < ends[i]) valid[i] = parse_clustering_record(starts[i], ends[i], table, clusterings[first + i]);
+  }, num_threads);
+  if(find(valid.begin(), valid.end(), false) != valid.end()) return NULL;
+  const char* q = ends.back();
+  next_line(q, end);
+  return q;
+}
+
+// give ids to the names of the table that the first clustering contains (see
+// parse_clusterings) and drop the others from the clusterings
+inline void set_elements(const vector<name_view>& names, element_dictionary<string>& elements,
+                         vector<label_clustering>& clusterings, const uint num_threads = 0){
+  const uint n = names.size();
+  vector<element_id> new_id(n, NO_ELEMENT);
+  for(element_id x = 0; x < n; x++)
+    if(clusterings.empty() || clusterings[0][x]) new_id[x] = elements.insert(names[x].to_string());
+  if(elements.size() < n)
+    parallel_for(0, clusterings.size(), [&](const uint i){
+      label_clustering compact(elements.size());
+      for(element_id x = 0; x < n; x++) if(new_id[x] != NO_ELEMENT) compact[new_id[x]] = clusterings[i][x];
+      clusterings[i].swap(compact);
+    }, num_threads);
+}
+
+// read clusterings in the format of write_clusterings from the characters in
+// [begin,end) into 'elements' and 'clusterings' (each numbering its clusters
+// 1,2,... in the order they are listed)
+// the name table lists the elements of the first clustering, so, as with
+// make_element_dictionary, only these elements are given ids (in the order of
+// the table) and other elements are ignored
+// after the name table, each record (the name of a clustering, which may not
+// contain a '.', and its clusters) ends with a '.', so the records are found
+// first and then parsed on num_threads threads (0 = one per core); the ids only
+// depend on the name table, so the result does not depend on the threads
+// return whether the header and all records could be read
+inline bool parse_clusterings(const char* begin, const char* end,
+                              element_dictionary<string>& elements,
+                              vector<label_clustering>& clusterings,
+                              const uint num_threads = 0){
+  elements.clear();
+  clusterings.clear();
+  const char* header_end = find_header_end(begin, end, true);
+  uint num_clusterings;
+  name_table table;
+  vector<name_view> names;
+  if(!header_end || !parse_header(begin, header_end, num_clusterings, table, names)) return false;
+  if(!parse_records(header_end, end, true, table, names.size(), num_clusterings, clusterings, num_threads)){
+    clusterings.clear();
+    return false;
+  }
+  set_elements(names, elements, clusterings, num_threads);
+  return true;
+}
+
+// ************************************************************************
+// ************************** binary format *******************************
+// ************************************************************************
+
+#define BINARY_CLUSTERINGS_MAGIC "gcclust\x1a"
+#define BINARY_CLUSTERINGS_VERSION 1
+// the file name extension of the binary format
+#define BINARY_CLUSTERINGS_EXTENSION ".gcb"
+
+// the header of the binary format (see above)
+struct binary_header{
+  char magic[8];
+  uint32_t version;
+  uint32_t label_width;     // bytes per label
+  uint32_t num_elements;
+  uint32_t num_clusterings;
+  uint64_t names_size;      // the number of characters of all names
+};
+
+// round up to the next multiple of 8
+inline uint64_t binary_align(const uint64_t size){ return (size + 7) & ~(uint64_t)7; }
+
+// return whether the characters in [begin,end) start with the magic of the binary format
+inline bool is_binary_clusterings(const char* begin, const char* end){
+  return ((size_t)(end - begin) >= sizeof(binary_header)) && !memcmp(begin, BINARY_CLUSTERINGS_MAGIC, 8);
+}
+
+// clusterings in the binary format, used in place, either in a mapped file or
+// in memory (which has to be 8-byte aligned)
+class binary_clusterings{
+  mapped_file* file;          // the mapped file, if they were read from one
+  const binary_header* header;
+  const uint64_t* name_offsets;
+  const char* names;
+  const uint8_t* labels;
+
+  // check the characters in [begin,end) and find the sections
+  void attach(const char* begin, const char* end){
+    if(!is_binary_clusterings(begin, end)) return;
+    const binary_header* h = (const binary_header*)begin;
+    if((h->version != BINARY_CLUSTERINGS_VERSION) ||
+       ((h->label_width != 1) && (h->label_width != 2) && (h->label_width != 4))) return;
+    // the sizes come from the file, so they are checked without sums or
+    // products that could overflow
+    const uint64_t size = end - begin;
+    const uint64_t offsets_start = binary_align(sizeof(binary_header));
+    const uint64_t names_start = offsets_start + ((uint64_t)h->num_elements + 1) * sizeof(uint64_t);
+    if((names_start > size) || (h->names_size > size - names_start)) return;
+    const uint64_t labels_start = binary_align(names_start + h->names_size);
+    if(labels_start > size) return;
+    if(h->num_clusterings &&
+       (h->num_elements > (size - labels_start) / h->label_width / h->num_clusterings)) return;
+    name_offsets = (const uint64_t*)(begin + offsets_start);
+    for(element_id x = 0; x < h->num_elements; x++)
+      if(name_offsets[x] > name_offsets[x + 1]) return;
+    if(name_offsets[h->num_elements] > h->names_size) return;
+    names = begin + names_start;
+    labels = (const uint8_t*)begin + labels_start;
+    header = h;
+  }
+
+public:
+  explicit binary_clusterings(const string& filename):
+    file(new mapped_file(filename)), header(NULL), name_offsets(NULL), names(NULL), labels(NULL)
+  {
+    if(file->good()) attach(file->begin(), file->end());
+  }
+  binary_clusterings(const char* begin, const char* end):
+    file(NULL), header(NULL), name_offsets(NULL), names(NULL), labels(NULL)
+  {
+    attach(begin, end);
+  }
+  ~binary_clusterings(){ delete file; }
+  binary_clusterings(const binary_clusterings&) = delete;
+  binary_clusterings& operator=(const binary_clusterings&) = delete;
+
+  // whether the clusterings could be read and are valid
+  bool good() const { return header != NULL; }
+  uint num_elements() const { return header->num_elements; }
+  uint num_clusterings() const { return header->num_clusterings; }
+  uint label_width() const { return header->label_width; }
+
+  // the name of element x
+  name_view name(const element_id x) const {
+    return name_view(names + name_offsets[x], name_offsets[x + 1] - name_offsets[x]);
+  }
+  // the label of element x in clustering i
+  uint32_t label(const uint i, const element_id x) const {
+    const size_t k = (size_t)i * header->num_elements + x;
+    switch(header->label_width){
+      case 1: return labels[k];
+      case 2: return ((const uint16_t*)labels)[k];
+      default: return ((const uint32_t*)labels)[k];
+    }
+  }
+  // the labels of clustering i in a label_clustering
+  label_clustering get_clustering(const uint i) const {
+    label_clustering C;
+    get_clustering(i, C);
+    return C;
+  }
+  // the labels of clustering i in C, reusing its memory
+  void get_clustering(const uint i, label_clustering& C) const {
+    C.resize(header->num_elements);
+    for(element_id x = 0; x < header->num_elements; x++) C[x] = label(i, x);
+  }
+};
+
+// give ids to the elements of B in the order of the file, return whether their names are distinct
+inline bool get_binary_elements(const binary_clusterings& B, element_dictionary<string>& elements){
+  elements.clear();
+  for(element_id x = 0; x < B.num_elements(); x++) elements.insert(B.name(x).to_string());
+  if(elements.size() == B.num_elements()) return true;
+  elements.clear();
+  return false;
+}
+
+// the distinct clusterings of B, read row by row from B in place so that
+// only the distinct clusterings are copied
+inline weighted_clusterings get_weighted_clusterings(const binary_clusterings& B){
+  weighted_clusterings result;
+  label_clustering row;
+  for(uint i = 0; i < B.num_clusterings(); i++){
+    B.get_clustering(i, row);
+    result.push_back(row);
+  }
+  return result;
+}
+
+// read clusterings in the binary format from the characters in [begin,end),
+// which have to be 8-byte aligned, return whether they are valid
+inline bool parse_binary_clusterings(const char* begin, const char* end,
+                                     element_dictionary<string>& elements,
+                                     vector<label_clustering>& clusterings){
+  elements.clear();
+  clusterings.clear();
+  const binary_clusterings B(begin, end);
+  if(!B.good() || !get_binary_elements(B, elements)) return false;
+  clusterings.reserve(B.num_clusterings());
+  for(uint i = 0; i < B.num_clusterings(); i++) clusterings.push_back(B.get_clustering(i));
+  return true;
+}
+
+// read clusterings in the text format (see parse_clusterings) or in the binary
+// format from the blocks of a decompressing_reader, the records of each block are
+// parsed while the next blocks are decompressed; return whether the input is valid
+inline bool parse_clusterings(decompressing_reader& reader,
+                              element_dictionary<string>& elements,
+                              vector<label_clustering>& clusterings,
+                              const uint num_threads = 0){
+  elements.clear();
+  clusterings.clear();
+  // the names point into the header, which does not change once it is complete
+  string header, text, block;
+  uint num_clusterings = 0;
+  name_table table;
+  vector<name_view> names;
+  bool have_header = false, binary = false, last = false;
+  while(!last){
+    last = !reader.next(block);
+    text.append(block);
+    if(!have_header){
+      if((text.size() < sizeof(binary_header)) && !last) continue;
+      // the binary format is read as a whole
+      if((binary = is_binary_clusterings(text.data(), text.data() + text.size()))) continue;
+      const char* header_end = find_header_end(text.data(), text.data() + text.size(), last);
+      if(!header_end){
+        if(last) return false;
+        continue;
+      }
+      header.assign(text.data(), header_end - text.data());
+      text.erase(0, header.size());
+      if(!parse_header(header.data(), header.data() + header.size(), num_clusterings, table, names)) return false;
+      have_header = true;
+    }
+    const char* consumed = parse_records(text.data(), text.data() + text.size(), last, table,
+                                         names.size(), num_clusterings, clusterings, num_threads);
+    if(!consumed){
+      clusterings.clear();
+      return false;
+    }
+    text.erase(0, consumed - text.data());
+  }
+  if(!reader.good()){
+    clusterings.clear();
+    return false;
+  }
+  if(binary) return parse_binary_clusterings(text.data(), text.data() + text.size(), elements, clusterings);
+  set_elements(names, elements, clusterings, num_threads);
+  return true;
+}
+
+// read clusterings from a file in the text format of write_clusterings or
+// in the binary format (see above), possibly compressed (see cclust_compress.h),
+// the text is parsed on num_threads threads (0 = one per core), return whether
+// the file could be read
+inline bool read_label_clusterings_from_file(const string& filename,
+                                             element_dictionary<string>& elements,
+                                             vector<label_clustering>& clusterings,
+                                             const uint num_threads = 0){
+  const mapped_file file(filename);
+  if(!file.good()) return false;
+  const compression_method method = get_compression(file.begin(), file.end());
+  if(method != COMPRESSION_NONE){
+    decompressing_reader reader(file.begin(), file.end(), method);
+    return parse_clusterings(reader, elements, clusterings, num_threads);
+  }
+  if(is_binary_clusterings(file.begin(), file.end()))
+    return parse_binary_clusterings(file.begin(), file.end(), elements, clusterings);
+  return parse_clusterings(file.begin(), file.end(), elements, clusterings, num_threads);
+}
+
+// ************************************************************************
+// ***************************** output ***********************************
+// ************************************************************************
+
+// the size of the buffer of a buffered_writer
+#define WRITE_BUFFER_SIZE (1 << 20)
+
+// collect the output in a large buffer and write it to the stream in blocks
+class buffered_writer{
+  ostream& os;
+  vector<char> buffer;
+  size_t used;
+
+public:
+  explicit buffered_writer(ostream& _os): os(_os), buffer(WRITE_BUFFER_SIZE), used(0) {}
+  ~buffered_writer(){ flush(); }
+  buffered_writer(const buffered_writer&) = delete;
+  buffered_writer& operator=(const buffered_writer&) = delete;
+
+  void flush(){
+    if(used) os.write(&buffer[0], used);
+    used = 0;
+  }
+  void write(const char* s, const size_t length){
+    if(used + length > buffer.size()){
+      flush();
+      if(length > buffer.size()){
+        os.write(s, length);
+        return;
+      }
+    }
+    memcpy(&buffer[used], s, length);
+    used += length;
+  }
+  void write(const name_view& name){ write(name.data, name.length); }
+  void put(const char c){
+    if(used == buffer.size()) flush();
+    buffer[used++] = c;
+  }
+  void write_number(uint64_t x){
+    char digits[20];
+    uint k = 0;
+    do digits[k++] = '0' + (x % 10); while(x /= 10);
+    if(used + k > buffer.size()) flush();
+    while(k) buffer[used++] = digits[--k];
+  }
+};
+
+// label clusterings with the names of their elements, as a source for write_text_clusterings
+class label_clusterings_source{
+  const element_dictionary<string>& elements;
+  const vector<label_clustering>& clusterings;
+
+public:
+  label_clusterings_source(const element_dictionary<string>& _elements, const vector<label_clustering>& _clusterings):
+    elements(_elements), clusterings(_clusterings) {}
+
+  uint num_elements() const { return elements.size(); }
+  uint num_clusterings() const { return clusterings.size(); }
+  name_view name(const element_id x) const { return name_view(elements[x].data(), elements[x].size()); }
+  uint32_t label(const uint i, const element_id x) const { return clusterings[i][x]; }
+};
+
+// write the clusterings of 'source' (a label_clusterings_source or binary_clusterings)
+// in the format of write_clusterings (cclust.h): the elements are listed by name,
+// the clusters by label and the members of each cluster by name
+template <typename S>
+void write_text_clusterings(ostream& os, const S& source){
+  const uint n = source.num_elements();
+  vector<element_id> by_name(n);
+  for(element_id x = 0; x < n; x++) by_name[x] = x;
+  sort(by_name.begin(), by_name.end(),
+       [&source](const element_id x, const element_id y){ return source.name(x) < source.name(y); });
+
+  buffered_writer out(os);
+  out.write_number(n);
+  out.put(' ');
+  out.write_number(source.num_clusterings());
+  out.put('\n');
+  for(vector<element_id>::const_iterator x = by_name.begin(); x != by_name.end(); x++){
+    out.write(source.name(*x));
+    out.put('\n');
+  }
+  // the elements of each clustering are sorted by label, stable in the order of the names
+  vector<uint32_t> labels(n);
+  vector<element_id> members(n);
+  vector<uint> first;
+  vector<pair<uint32_t, element_id> > pairs;
+  for(uint i = 0; i < source.num_clusterings(); i++){
+    uint32_t max_label = 0;
+    for(uint r = 0; r < n; r++) max_label = max(max_label, labels[r] = source.label(i, by_name[r]));
+    if(max_label <= 2 * n){
+      first.assign(max_label + 2, 0);
+      for(uint r = 0; r < n; r++) first[labels[r] + 1]++;
+      for(uint32_t l = 1; l <= max_label; l++) first[l + 1] += first[l];
+      for(uint r = 0; r < n; r++) members[first[labels[r]]++] = by_name[r];
+    } else {
+      pairs.clear();
+      for(uint r = 0; r < n; r++) pairs.push_back(pair<uint32_t, element_id>(labels[r], r));
+      sort(pairs.begin(), pairs.end());
+      for(uint r = 0; r < n; r++) members[r] = by_name[pairs[r].second];
+    }
+    out.write("clustering", 10);
+    out.write_number(i);
+    out.put('\n');
+    uint32_t previous = 0;
+    for(uint r = 0; r < n; r++){
+      const uint32_t l = source.label(i, members[r]);
+      if(!l) continue;
+      if(previous) out.put((l == previous) ? ',' : ';');
+      previous = l;
+      out.write(source.name(members[r]));
+    }
+    if(previous) out.put(';');
+    out.write(".\n", 2);
+  }
+}
+
+// write clusterings in the format of write_clusterings (cclust.h), see above
+inline void write_label_clusterings(ostream& os, const element_dictionary<string>& elements,
+                                    const vector<label_clustering>& clusterings){
+  write_text_clusterings(os, label_clusterings_source(elements, clusterings));
+}
+
+// write clusterings to a file in the text format (see above), compressed according
+// to its name (see cclust_compress.h), return success
+inline bool write_label_clusterings_to_file(const string& filename, const element_dictionary<string>& elements,
+                                            const vector<label_clustering>& clusterings){
+  output_file out(filename);
+  if(!out.good()) return false;
+  write_label_clusterings(out.stream(), elements, clusterings);
+  return out.close();
+}
+
+// write the clusterings of 'source' (see write_text_clusterings) to a file in the
+// binary format, compressed according to its name (see cclust_compress.h), return success
+template <typename S>
+bool write_binary_clusterings_to_file(const string& filename, const S& source){
+  binary_header h;
+  memcpy(h.magic, BINARY_CLUSTERINGS_MAGIC, 8);
+  h.version = BINARY_CLUSTERINGS_VERSION;
+  h.num_elements = source.num_elements();
+  h.num_clusterings = source.num_clusterings();
+  uint32_t max_label = 0;
+  for(uint i = 0; i < h.num_clusterings; i++)
+    for(element_id x = 0; x < h.num_elements; x++) max_label = max(max_label, source.label(i, x));
+  h.label_width = (max_label < 0x100) ? 1 : ((max_label < 0x10000) ? 2 : 4);
+  vector<uint64_t> offsets(1, 0);
+  for(element_id x = 0; x < h.num_elements; x++) offsets.push_back(offsets.back() + source.name(x).length);
+  h.names_size = offsets.back();
+
+  output_file out(filename);
+  if(!out.good()) return false;
+  ostream& fout = out.stream();
+  const char padding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  fout.write((const char*)&h, sizeof(h));
+  fout.write(padding, binary_align(sizeof(h)) - sizeof(h));
+  fout.write((const char*)&offsets[0], offsets.size() * sizeof(uint64_t));
+  for(element_id x = 0; x < h.num_elements; x++) fout.write(source.name(x).data, source.name(x).length);
+  fout.write(padding, binary_align(h.names_size) - h.names_size);
+  // the labels, narrowed clustering by clustering
+  vector<uint8_t> row((size_t)h.num_elements * h.label_width);
+  for(uint i = 0; i < h.num_clusterings; i++){
+    for(element_id x = 0; x < h.num_elements; x++)
+      switch(h.label_width){
+        case 1: row[x] = (uint8_t)source.label(i, x); break;
+        case 2: ((uint16_t*)&row[0])[x] = (uint16_t)source.label(i, x); break;
+        default: ((uint32_t*)&row[0])[x] = source.label(i, x); break;
+      }
+    if(!row.empty()) fout.write((const char*)&row[0], row.size());
+  }
+  const uint64_t labels_size = (uint64_t)h.num_clusterings * h.num_elements * h.label_width;
+  fout.write(padding, binary_align(labels_size) - labels_size);
+  return out.close();
+}
+
+// write clusterings to a file in the binary format (see above), return success
+inline bool write_binary_clusterings_to_file(const string& filename, const element_dictionary<string>& elements,
+                                             const vector<label_clustering>& clusterings){
+  for(vector<label_clustering>::const_iterator C = clusterings.begin(); C != clusterings.end(); C++)
+    if(C->size() != elements.size()) return false;
+  return write_binary_clusterings_to_file(filename, label_clusterings_source(elements, clusterings));
+}
+
+// convert a file of clusterings in the text format to the binary format, return success
+inline bool convert_text_to_binary_clusterings(const string& text_filename, const string& binary_filename){
+  element_dictionary<string> elements;
+  vector<label_clustering> clusterings;
+  return read_label_clusterings_from_file(text_filename, elements, clusterings) &&
+         write_binary_clusterings_to_file(binary_filename, elements, clusterings);
+}
+
+// convert a file of clusterings in the binary format to the text format, writing
+// straight from the mapped file, return success
+inline bool convert_binary_to_text_clusterings(const string& binary_filename, const string& text_filename){
+  const binary_clusterings B(binary_filename);
+  if(!B.good()) return false;
+  output_file out(text_filename);
+  if(!out.good()) return false;
+  write_text_clusterings(out.stream(), B);
+  return out.close();
+}
+
+#endif
@@ -0,0 +1,187 @@
+/* This is cclust_label_matrix.h - the labels of all clusterings, element by element
+ *
+ * row i of the matrix holds the labels of element i in all (distinct)
+ * clusterings, in the smallest integer type that can hold the (canonical)
+ * labels. The number of clusterings co-clustering i and j is then the number
+ * of equal entries in two contiguous rows, which is counted 32 (AVX2) or 16
+ * (SSE2) bytes at a time by comparing them and counting the bits of the mask,
+ * depending on the instruction set the program is compiled for. The rows are
+ * padded with zeros to whole vectors, so the padding is always equal
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_label_matrix_h
+#define cclust_label_matrix_h
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "cclust_labels.h"
+#include "cclust_parallel.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// the number of bytes compared at a time
+#ifdef __AVX2__
+#define LABEL_VECTOR_BYTES 32
+#else
+#define LABEL_VECTOR_BYTES 16
+#endif
+// without vector instructions, counting row by row does not pay off
+#if defined(__AVX2__) || defined(__SSE2__)
+#define LABEL_MATRIX_VECTORIZED
+#endif
+
+class label_matrix{
+  uint n;                   // number of elements
+  uint m;                   // number of distinct clusterings
+  uint width;               // bytes per label (1, 2 or 4)
+  uint stride;              // bytes per row, a multiple of LABEL_VECTOR_BYTES
+  vector<uint8_t> storage;  // n rows plus room to align the first one
+  uint8_t* data;
+  bool weighted;            // some clustering occurs more than once
+  // the columns are ordered by multiplicity, so in each vector of a row, the
+  // lanes of the clusterings of equal multiplicity form a few groups
+  vector<uint> columns;             // the clustering of each column
+  vector<uint> vector_groups;       // the first group of each vector (and the end)
+  vector<uint32_t> group_lanes;     // the lane bits of each group (see equal_lanes)
+  vector<uint> group_multiplicity;
+
+  template <typename L>
+  void fill_rows(const weighted_clusterings& clusterings, const uint num_threads){
+    parallel_for(0, n, [&](const element_id i){
+      L* row = (L*)(data + (size_t)i * stride);
+      for(uint c = 0; c < m; c++) row[c] = (L)clusterings.clusterings[columns[c]][i];
+    }, num_threads);
+  }
+
+#if !defined(__AVX2__) && !defined(__SSE2__)
+  // return the mask of the zero labels of a word, with the bit of each
+  // label at its first byte (as in equal_lanes)
+  inline uint32_t zero_lanes(const uint64_t x) const {
+    // the top bit of a lane is set in ~t if and only if the lane is zero
+    const uint64_t low = (width == 1) ? 0x7F7F7F7F7F7F7F7FULL :
+                         ((width == 2) ? 0x7FFF7FFF7FFF7FFFULL : 0x7FFFFFFF7FFFFFFFULL);
+    const uint64_t t = ((x & low) + low) | x;
+    // move the top bit of each lane to the first bit of the lane, then one bit per byte
+    const uint64_t first_bits = (~t & ~low) >> (8 * width - 1);
+    return (uint32_t)((first_bits * 0x0102040810204080ULL) >> 56);
+  }
+#endif
+
+  // return the mask of the equal labels of the rows of i and j at byte k, the
+  // bit of each label is the bit of its first byte
+  inline uint32_t equal_lanes(const uint8_t* row_i, const uint8_t* row_j, const uint k) const {
+    const uint32_t lane_bits = (width == 1) ? 0xFFFFFFFFU : ((width == 2) ? 0x55555555U : 0x11111111U);
+#if defined(__AVX2__)
+    const __m256i a = _mm256_load_si256((const __m256i*)(row_i + k));
+    const __m256i b = _mm256_load_si256((const __m256i*)(row_j + k));
+    switch(width){
+      case 1: return _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+      case 2: return _mm256_movemask_epi8(_mm256_cmpeq_epi16(a, b)) & lane_bits;
+      default: return _mm256_movemask_epi8(_mm256_cmpeq_epi32(a, b)) & lane_bits;
+    }
+#elif defined(__SSE2__)
+    const __m128i a = _mm_load_si128((const __m128i*)(row_i + k));
+    const __m128i b = _mm_load_si128((const __m128i*)(row_j + k));
+    switch(width){
+      case 1: return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+      case 2: return _mm_movemask_epi8(_mm_cmpeq_epi16(a, b)) & lane_bits;
+      default: return _mm_movemask_epi8(_mm_cmpeq_epi32(a, b)) & lane_bits;
+    }
+#else
+    // compare 8 bytes at a time in 64-bit words (with the first byte lowest)
+    uint32_t mask = 0;
+    for(uint w = 0; w < LABEL_VECTOR_BYTES; w += 8){
+      uint64_t a, b;
+      memcpy(&a, row_i + k + w, 8);
+      memcpy(&b, row_j + k + w, 8);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+      a = __builtin_bswap64(a);
+      b = __builtin_bswap64(b);
+#endif
+      mask |= zero_lanes(a ^ b) << w;
+    }
+    return mask & lane_bits;
+#endif
+  }
+
+public:
+  label_matrix(): n(0), m(0), width(1), stride(0), data(NULL), weighted(false) {}
+
+  // transpose the distinct clusterings into rows of elements, the rows are
+  // distributed over num_threads threads (0 = one per core)
+  explicit label_matrix(const weighted_clusterings& clusterings, const uint num_threads = 0):
+    n(clusterings.empty() ? 0 : clusterings.clusterings.begin()->size()), m(clusterings.size()),
+    weighted(false), columns(m)
+  {
+    const vector<uint>& multiplicities = clusterings.multiplicities;
+    uint32_t max_label = 0;
+    for(uint c = 0; c < m; c++){
+      for(element_id i = 0; i < n; i++) max_label = max(max_label, clusterings.clusterings[c][i]);
+      if(multiplicities[c] > 1) weighted = true;
+      columns[c] = c;
+    }
+    width = (max_label < 0x100) ? 1 : ((max_label < 0x10000) ? 2 : 4);
+    stride = ((m * width + LABEL_VECTOR_BYTES - 1) / LABEL_VECTOR_BYTES) * LABEL_VECTOR_BYTES;
+    if(!stride) stride = LABEL_VECTOR_BYTES;
+    storage.assign((size_t)n * stride + LABEL_VECTOR_BYTES, 0);
+    data = &storage[0] + ((LABEL_VECTOR_BYTES - ((uintptr_t)&storage[0] % LABEL_VECTOR_BYTES)) % LABEL_VECTOR_BYTES);
+
+    if(weighted){
+      stable_sort(columns.begin(), columns.end(),
+                  [&](const uint c, const uint d){ return multiplicities[c] < multiplicities[d]; });
+      const uint lanes = LABEL_VECTOR_BYTES / width;
+      for(uint c = 0; c < m; c++){
+        if(!(c % lanes)) vector_groups.push_back(group_lanes.size());
+        const uint multiplicity = multiplicities[columns[c]];
+        if((c % lanes) && (group_multiplicity.back() == multiplicity))
+          group_lanes.back() |= 1U << ((c % lanes) * width);
+        else {
+          group_lanes.push_back(1U << ((c % lanes) * width));
+          group_multiplicity.push_back(multiplicity);
+        }
+      }
+      vector_groups.push_back(group_lanes.size());
+    }
+    switch(width){
+      case 1: fill_rows<uint8_t>(clusterings, num_threads); break;
+      case 2: fill_rows<uint16_t>(clusterings, num_threads); break;
+      default: fill_rows<uint32_t>(clusterings, num_threads); break;
+    }
+  }
+  // the storage is aligned to the object it belongs to, so copies are not supported
+  label_matrix(const label_matrix&) = delete;
+  label_matrix& operator=(const label_matrix&) = delete;
+
+  uint num_elements() const { return n; }
+  uint num_clusterings() const { return m; }
+  uint label_width() const { return width; }
+
+  // return the number of clusterings (with multiplicities) co-clustering i and j
+  inline uint64_t count(const element_id i, const element_id j) const {
+    const uint8_t* row_i = data + (size_t)i * stride;
+    const uint8_t* row_j = data + (size_t)j * stride;
+    uint64_t equal = 0;
+    if(!weighted){
+      // the padding is always equal, so it is subtracted in the end
+      for(uint k = 0; k < stride; k += LABEL_VECTOR_BYTES)
+        equal += __builtin_popcount(equal_lanes(row_i, row_j, k));
+      return equal - (stride / width - m);
+    }
+    // each group of lanes adds its multiplicity per equal label, the padding is in no group
+    for(uint v = 0; v + 1 < vector_groups.size(); v++){
+      const uint32_t mask = equal_lanes(row_i, row_j, v * LABEL_VECTOR_BYTES);
+      for(uint g = vector_groups[v]; g < vector_groups[v + 1]; g++)
+        equal += (uint64_t)__builtin_popcount(mask & group_lanes[g]) * group_multiplicity[g];
+    }
+    return equal;
+  }
+};
+
+#endif
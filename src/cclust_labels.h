@@ -0,0 +1,165 @@
+/* This is cclust_labels.h - a dense representation of clusterings
+ *
+ * an element_dictionary maps the names of the elements to consecutive
+ * integer ids once (at load time) and a label_clustering stores the
+ * cluster number of element i at position i. all hot routines in cclust.h
+ * work on these contiguous arrays; names are only looked up for output
+ *
+ * clusterings that are equal up to the numbering of their clusters are
+ * collapsed into one distinct clustering with a multiplicity by
+ * weighted_clusterings, so that they are only processed once
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_labels_h
+#define cclust_labels_h
+
+#include <stdint.h>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+using namespace std;
+
+typedef uint32_t element_id;
+const element_id NO_ELEMENT = (element_id)-1;
+
+// label_clustering is an alias for vector<uint32_t>, indexed by element ids
+// as in clustering<T>, 0 is a special cluster for 'unclustered yet'
+class label_clustering: public vector<uint32_t>{
+public:
+  label_clustering(): vector<uint32_t>(){}
+  explicit label_clustering(const size_t num_elements, const uint32_t label = 0):
+    vector<uint32_t>(num_elements, label){}
+};
+
+// a bijection between the element names and the ids 0...size()-1
+template <typename T>
+class element_dictionary{
+  vector<T> names;
+  map<T,element_id> ids;
+public:
+  // return the id of 'name', giving it the next free id if it is new
+  element_id insert(const T& name){
+    typename map<T,element_id>::const_iterator i = ids.find(name);
+    if(i != ids.end()) return i->second;
+    ids.insert(pair<T,element_id>(name, (element_id)names.size()));
+    names.push_back(name);
+    return names.size() - 1;
+  }
+  // return the id of 'name' or NO_ELEMENT if it is unknown
+  element_id find(const T& name) const{
+    typename map<T,element_id>::const_iterator i = ids.find(name);
+    return (i == ids.end()) ? NO_ELEMENT : i->second;
+  }
+  const T& operator[](const element_id id) const { return names[id]; }
+  uint size() const { return names.size(); }
+  bool empty() const { return names.empty(); }
+  void clear(){ names.clear(); ids.clear(); }
+};
+
+
+// return the number of clusters in the clustering C
+inline uint num_clusters(const label_clustering& C){
+  vector<bool> seen;
+  uint clusters = 0;
+  for(label_clustering::const_iterator i = C.begin(); i != C.end(); i++)
+    if(*i){ // 0 is a special cluster for 'unclustered yet'
+      if(*i >= seen.size()) seen.resize(*i + 1, false);
+      if(!seen[*i]){ seen[*i] = true; clusters++; }
+    }
+  return clusters;
+}
+
+// add a cluster to the clustering C
+inline void add_cluster(label_clustering& C, const vector<element_id>& cluster){
+  uint cluster_num = num_clusters(C) + 1;
+  for(vector<element_id>::const_iterator x = cluster.begin(); x != cluster.end(); x++)
+    C[*x] = cluster_num;
+}
+
+// return whether a and b are co-clustered in C
+inline bool coed(const element_id a, const element_id b, const label_clustering& C){
+  return C[a] == C[b];
+}
+
+// determine the clustered elements
+inline vector<element_id> get_clustered_elements(const label_clustering& C){
+  vector<element_id> result;
+  for(element_id i = 0; i < C.size(); i++)
+    if(C[i]) result.push_back(i);
+  return result;
+}
+// determine the unclustered elements
+inline vector<element_id> get_unclustered_elements(const label_clustering& C){
+  vector<element_id> result;
+  for(element_id i = 0; i < C.size(); i++)
+    if(!C[i]) result.push_back(i);
+  return result;
+}
+
+// relabel the clusters of C in the order of their first element, 0 stays 0
+inline label_clustering get_canonical_labels(const label_clustering& C){
+  label_clustering result(C.size());
+  map<uint32_t, uint32_t> new_labels;
+  for(element_id x = 0; x < C.size(); x++) if(C[x]){
+    map<uint32_t, uint32_t>::const_iterator l = new_labels.find(C[x]);
+    if(l == new_labels.end())
+      l = new_labels.insert(pair<uint32_t, uint32_t>(C[x], new_labels.size() + 1)).first;
+    result[x] = l->second;
+  }
+  return result;
+}
+
+// FNV-1a hash of the labels of C
+inline uint64_t hash_labels(const label_clustering& C){
+  uint64_t h = 14695981039346656037ULL;
+  for(label_clustering::const_iterator i = C.begin(); i != C.end(); i++){
+    h ^= *i;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+// the distinct clusterings of a vector of clusterings (in the order of their
+// first occurrence) with the number of times each of them occurs
+class weighted_clusterings{
+  // the distinct clusterings by the hash of their labels
+  unordered_map<uint64_t, vector<uint> > buckets;
+public:
+  vector<label_clustering> clusterings;   // the distinct clusterings, canonically labeled
+  vector<uint> multiplicities;            // the number of occurrences of each of them
+  vector<uint> first;                     // the first input clustering equal to each of them
+  vector<uint> index_of;                  // index_of[i]: the distinct clustering equal to input i
+
+  weighted_clusterings(){}
+  explicit weighted_clusterings(const vector<label_clustering>& input){
+    for(uint i = 0; i < input.size(); i++) push_back(input[i]);
+  }
+
+  // add the next input clustering, only a new distinct clustering is stored
+  void push_back(const label_clustering& C){
+    const label_clustering canonical = get_canonical_labels(C);
+    vector<uint>& bucket = buckets[hash_labels(canonical)];
+    uint d = 0;
+    for(; d < bucket.size(); d++)
+      if(clusterings[bucket[d]] == canonical) break;
+    if(d == bucket.size()){
+      bucket.push_back(clusterings.size());
+      clusterings.push_back(canonical);
+      multiplicities.push_back(0);
+      first.push_back(index_of.size());
+    }
+    multiplicities[bucket[d]]++;
+    index_of.push_back(bucket[d]);
+  }
+
+  // the number of distinct clusterings
+  uint size() const { return clusterings.size(); }
+  bool empty() const { return clusterings.empty(); }
+  // the number of input clusterings
+  uint total() const { return index_of.size(); }
+};
+
+#endif
@@ -0,0 +1,131 @@
+/* This is cclust_parallel.h - helpers to spread independent pieces of
+ * work of the routines in cclust.h over several threads
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_parallel_h
+#define cclust_parallel_h
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <algorithm>
+
+using namespace std;
+
+// return the number of threads to use, 0 means 'one per core'
+inline uint num_worker_threads(const uint requested = 0){
+  if(requested) return requested;
+  const uint cores = thread::hardware_concurrency();
+  return cores ? cores : 1;
+}
+
+// call f(i) for all i in [begin, end) using num_threads threads (0 = one per core)
+// the indices are handed out one at a time, so rows of different lengths
+// (like the rows of a triangular matrix) are balanced between the threads
+template <typename F>
+void parallel_for(const uint begin, const uint end, F f, const uint num_threads = 0){
+  if(begin >= end) return;
+  const uint threads = min(num_worker_threads(num_threads), end - begin);
+  if(threads == 1){
+    for(uint i = begin; i < end; i++) f(i);
+    return;
+  }
+  atomic<uint> next(begin);
+  vector<thread> workers;
+  workers.reserve(threads - 1);
+  for(uint t = 1; t < threads; t++)
+    workers.push_back(thread([&](){
+      for(uint i = next++; i < end; i = next++) f(i);
+    }));
+  // the calling thread does its share as well
+  for(uint i = next++; i < end; i = next++) f(i);
+  for(vector<thread>::iterator t = workers.begin(); t != workers.end(); t++) t->join();
+}
+
+// a pool of threads working on tasks of type T, each worker has its own deque:
+// it pushes and pops tasks at the back and, if its deque is empty, it steals the
+// oldest (for a search tree, that is the largest) task from the front of another
+// deque. run() returns when all tasks, including those pushed meanwhile, are done
+template <typename T>
+class work_stealing_pool{
+  class task_queue{
+  public:
+    mutex lock;
+    deque<T> tasks;
+  };
+  vector<task_queue> queues;
+  atomic<uint> pending;   // tasks pushed but not completed yet
+  atomic<uint> idle;      // workers looking for a task
+
+  // get a task of our own or steal one
+  bool pop(const uint worker, T& task){
+    {
+      lock_guard<mutex> lock(queues[worker].lock);
+      if(!queues[worker].tasks.empty()){
+        task = queues[worker].tasks.back();
+        queues[worker].tasks.pop_back();
+        return true;
+      }
+    }
+    for(uint i = 1; i < queues.size(); i++){
+      task_queue& victim = queues[(worker + i) % queues.size()];
+      lock_guard<mutex> lock(victim.lock);
+      if(!victim.tasks.empty()){
+        task = victim.tasks.front();
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename F>
+  void work(F& f, const uint worker){
+    bool is_idle = false;
+    T task;
+    while(true){
+      if(pop(worker, task)){
+        if(is_idle){ idle--; is_idle = false; }
+        f(task, worker);
+        pending--;
+      } else {
+        if(!pending) break;
+        if(!is_idle){ idle++; is_idle = true; }
+        this_thread::yield();
+      }
+    }
+    if(is_idle) idle--;
+  }
+
+public:
+  // use num_threads workers (0 = one per core)
+  explicit work_stealing_pool(const uint num_threads = 0):
+    queues(num_worker_threads(num_threads)), pending(0), idle(0) {}
+
+  uint size() const { return queues.size(); }
+  // return whether some worker has nothing to do
+  bool hungry() const { return idle > 0; }
+
+  // add a task to the deque of 'worker', this may be called from within f
+  void push(const uint worker, const T& task){
+    pending++;
+    lock_guard<mutex> lock(queues[worker].lock);
+    queues[worker].tasks.push_back(task);
+  }
+
+  // call f(task, worker) for all tasks, the calling thread is worker 0
+  template <typename F>
+  void run(F f){
+    vector<thread> workers;
+    for(uint w = 1; w < queues.size(); w++)
+      workers.push_back(thread([this, &f, w](){ work(f, w); }));
+    work(f, 0);
+    for(vector<thread>::iterator t = workers.begin(); t != workers.end(); t++) t->join();
+  }
+};
+
+#endif
@@ -3,17 +3,22 @@
 
 #include "cclust.h"
 #include <iostream>
+#include <chrono>
 #include <glibmm.h>
 
-template <typename T>
+// C is the type of the clusterings to work on, that is, the dense label_clustering
+template <typename C>
 class preprocess_cclust_thread{
 private:
   Glib::Thread *thread;
   uint number_of_runs;
 
   // TODO: mutex these
-  vector<clustering<T> > *clusterings;
-  clustering<T> *consensus;
+  const weighted_clusterings *clusterings;
+  // the co-association matrix is computed here if it is empty,
+  // so that the following search can use it as well
+  coassociation_matrix *coassoc;
+  C *consensus;
 
   // maybe a mutex for this one? - maybe not.. we only read it
   const bool *cancel_computation;
@@ -24,27 +29,28 @@ private:
 
   // ==================================================
 	void run(){
-    // apply preprocessing at most 'number_of_runs' times
-    uint old_clustered;
-    uint new_clustered = 0;
-    for(uint i = 0; i < number_of_runs; i++){
-      old_clustered = new_clustered;
-      *consensus = apply_preprocessing<T>(*clusterings, *consensus,
-                                          progress_pc, cancel_computation);
-      new_clustered = get_clustered_elements(*consensus).size();
-      if(old_clustered == new_clustered) break;
+    // apply preprocessing at most 'number_of_runs' rounds, the engine keeps
+    // its state between the rounds
+    if(coassoc->empty())
+      *coassoc = coassociation_matrix(*clusterings, 0, cancel_computation);
+    if(number_of_runs && !coassoc->empty()){
+      preprocessing_engine engine(*coassoc, *consensus, progress_pc, cancel_computation);
+      for(uint i = 0; (i < number_of_runs) && !engine.done(); i++)
+        if(!engine.apply_round(progress_pc, cancel_computation)) break;
+      *consensus = (cancel_computation && *cancel_computation) ? C() : engine.get_clustering();
     }
     disp_computation_done->emit();
   }
 
 public:
-	preprocess_cclust_thread(vector<clustering<T> > *_clusterings,
-                      clustering<T> *_consensus,
+	preprocess_cclust_thread(const weighted_clusterings *_clusterings,
+                      coassociation_matrix *_coassoc,
+                      C *_consensus,
                       const uint nr_runs,
                       const bool* cancel_comp,
                       double *_progress_pc,
                       Glib::Dispatcher *comp_done)
-    :number_of_runs(nr_runs),clusterings(_clusterings),
+    :number_of_runs(nr_runs),clusterings(_clusterings),coassoc(_coassoc),
     consensus(_consensus),cancel_computation(cancel_comp),
     progress_pc(_progress_pc),disp_computation_done(comp_done){}
 
@@ -60,14 +66,18 @@ public:
 
 
 
-template <typename T>
+template <typename C>
 class searchtree_cclust_thread{
 private:
   Glib::Thread *thread;
 
   // TODO: mutex these
-  vector<clustering<T> > *clusterings;
-  clustering<T> *consensus;
+  const coassociation_matrix *coassoc;
+  C *consensus;
+  search_method method;
+  uint num_threads;
+  // the number of times each of the reduction rules applied
+  vector<uint> rule_hits;
 
   // maybe a mutex for this one? - maybe not.. we only read it
   const bool *cancel_computation;
@@ -79,18 +89,20 @@ private:
 	void run(){
     // do brute force search
     *consensus =
-      get_consensus_clustering_brute(*clusterings, *consensus,
-          progress_pc, cancel_computation);
+      get_consensus_clustering_search(*coassoc, *consensus, method,
+          progress_pc, cancel_computation, num_threads, &rule_hits);
     disp_computation_done->emit();
   }
 
 public:
-	searchtree_cclust_thread(vector<clustering<T> > *_clusterings,
-                      clustering<T> *_consensus,
+	searchtree_cclust_thread(const coassociation_matrix *_coassoc,
+                      C *_consensus,
+                      const search_method _method,
+                      const uint _num_threads,
                       const bool* cancel_comp,
                       double *_progress_pc,
                       Glib::Dispatcher *comp_done)
-    :clusterings(_clusterings), consensus(_consensus),
+    :coassoc(_coassoc), consensus(_consensus), method(_method), num_threads(_num_threads),
     cancel_computation(cancel_comp), progress_pc(_progress_pc),
     disp_computation_done(comp_done){}
 
@@ -98,9 +110,183 @@ public:
     // create a joinable thread
     thread = Glib::Thread::create(sigc::mem_fun(*this, &searchtree_cclust_thread::run), true);
   }
+  // read this only after the computation is done
+  const vector<uint>& get_rule_hits() const { return rule_hits; }
 	void wait(){
     return thread->join();
   }
 };
 
+
+// runs restarts of the pivot heuristic (with or without local search) in the
+// background, the progress and the cost of the best clustering found so far
+// (0 = none yet) can be read at any time
+template <typename C>
+class heuristic_cclust_thread{
+private:
+  Glib::Thread *thread;
+
+  const coassociation_matrix *coassoc;
+  C *consensus;
+  heuristic_method method;
+  uint restarts;
+  uint num_threads;
+
+  // maybe a mutex for this one? - maybe not.. we only read it
+  const bool *cancel_computation;
+
+  // the GUI thread reads these while the workers run
+  atomic<double> progress_pc;
+  atomic<uint64_t> best_cost;
+  Glib::Dispatcher *disp_computation_done;
+
+  // ==================================================
+	void run(){
+    *consensus =
+      get_consensus_clustering_heuristic(*coassoc, *consensus, method, restarts,
+          &progress_pc, cancel_computation, &best_cost, num_threads);
+    disp_computation_done->emit();
+  }
+
+public:
+	heuristic_cclust_thread(const coassociation_matrix *_coassoc,
+                      C *_consensus,
+                      const heuristic_method _method,
+                      const uint _restarts,
+                      const uint _num_threads,
+                      const bool* cancel_comp,
+                      Glib::Dispatcher *comp_done)
+    :coassoc(_coassoc), consensus(_consensus), method(_method), restarts(_restarts),
+    num_threads(_num_threads), cancel_computation(cancel_comp), progress_pc(0),
+    best_cost(0), disp_computation_done(comp_done){}
+
+	void start(){
+    // create a joinable thread
+    thread = Glib::Thread::create(sigc::mem_fun(*this, &heuristic_cclust_thread::run), true);
+  }
+	void wait(){
+    return thread->join();
+  }
+  double get_progress() const { return progress_pc; }
+  uint64_t get_best_cost() const { return best_cost; }
+};
+
+
+// finds the input clustering with the smallest sum of distances to all others
+// (a 2-approximation of the consensus) in the background
+template <typename C>
+class medoid_cclust_thread{
+private:
+  Glib::Thread *thread;
+
+  const weighted_clusterings *clusterings;
+  C *consensus;
+  uint num_threads;
+
+  // maybe a mutex for this one? - maybe not.. we only read it
+  const bool *cancel_computation;
+
+  double *progress_pc;
+  uint64_t *cost;
+  uint64_t *lower_bound;
+  Glib::Dispatcher *disp_computation_done;
+
+  // ==================================================
+	void run(){
+    *consensus = get_medoid_clustering(*clusterings, cost, lower_bound,
+        progress_pc, cancel_computation, num_threads);
+    disp_computation_done->emit();
+  }
+
+public:
+	medoid_cclust_thread(const weighted_clusterings *_clusterings,
+                      C *_consensus,
+                      const uint _num_threads,
+                      const bool* cancel_comp,
+                      double *_progress_pc,
+                      uint64_t *_cost,
+                      uint64_t *_lower_bound,
+                      Glib::Dispatcher *comp_done)
+    :clusterings(_clusterings), consensus(_consensus), num_threads(_num_threads),
+    cancel_computation(cancel_comp), progress_pc(_progress_pc), cost(_cost),
+    lower_bound(_lower_bound), disp_computation_done(comp_done){}
+
+	void start(){
+    // create a joinable thread
+    thread = Glib::Thread::create(sigc::mem_fun(*this, &medoid_cclust_thread::run), true);
+  }
+	void wait(){
+    return thread->join();
+  }
+};
+
+
+// computes the sum of distances of each clustering to all other clusterings
+// in the background, the partial sums can be read at any time with get_sums()
+class distances_cclust_thread{
+private:
+  Glib::Thread *thread;
+
+  // the sums are computed per distinct clustering
+  const weighted_clusterings *distinct;
+  vector<uint64_t> sums;
+  mutex sums_mutex;
+
+  // the GUI thread accesses these while the workers run
+  atomic<bool> cancel_computation;
+  atomic<bool> complete;
+  atomic<double> progress_pc;
+
+  // emitted when new partial sums are available (at most every 100ms)
+  Glib::Dispatcher *disp_progress;
+  Glib::Dispatcher *disp_computation_done;
+
+  // ==================================================
+	void run(){
+    chrono::steady_clock::time_point last_progress = chrono::steady_clock::now();
+    // the callback is called with sums_mutex locked, so last_progress is safe
+    complete = get_distance_sums(*distinct, sums, [&](){
+          const chrono::steady_clock::time_point now = chrono::steady_clock::now();
+          if(now - last_progress > chrono::milliseconds(100)){
+            last_progress = now;
+            disp_progress->emit();
+          }
+        }, &sums_mutex, &progress_pc, &cancel_computation);
+    disp_computation_done->emit();
+  }
+
+public:
+	distances_cclust_thread(const weighted_clusterings *_distinct,
+                      Glib::Dispatcher *_progress,
+                      Glib::Dispatcher *comp_done)
+    :thread(NULL), distinct(_distinct), cancel_computation(false),
+    complete(false), progress_pc(0), disp_progress(_progress),
+    disp_computation_done(comp_done){}
+
+	void start(){
+    // create a joinable thread
+    thread = Glib::Thread::create(sigc::mem_fun(*this, &distances_cclust_thread::run), true);
+  }
+  void cancel(){
+    cancel_computation = true;
+  }
+	void wait(){
+    if(thread) thread->join();
+    thread = NULL;
+  }
+
+  // return the (partial) sums of distances of each input clustering,
+  // empty if the computation did not start yet
+  vector<uint64_t> get_sums(){
+    lock_guard<mutex> lock(sums_mutex);
+    vector<uint64_t> result;
+    if(sums.size() != distinct->size() || distinct->empty()) return result;
+    result.resize(distinct->total());
+    for(uint i = 0; i < result.size(); i++) result[i] = sums[distinct->index_of[i]];
+    return result;
+  }
+  double get_progress() const { return progress_pc; }
+  bool is_complete() const { return complete; }
+};
+
 #endif
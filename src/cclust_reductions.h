@@ -0,0 +1,198 @@
+/* This is cclust_reductions.h - data reduction rules for the instances that
+ * are handed to the exact search
+ *
+ * the rules work on the weights s(u,v) = co(u,v) - anti(u,v) of (super-)elements,
+ * as in weighted cluster editing, and each of them is sound by moving a single
+ * (super-)element u in an optimal clustering that obeys all earlier decisions:
+ * - heavy edge: if s(u,v) >= sum_{w != u,v} |s(u,w)|, moving u into the cluster
+ *   of v does not cost anything, so u and v are merged (u must be unclustered
+ *   and may not be separated from anything)
+ * - heavy non-edge: if s(u,v) < 0 and -s(u,v) >= sum_{w != v} max(s(u,w), 0),
+ *   taking u out of a cluster containing v does not cost anything, so u and v
+ *   are separated for good
+ * - isolation: if s(u,w) <= 0 for all w that u is not separated from, u is a
+ *   cluster of its own and is removed from the instance
+ * elements with different labels in the given clustering are separated and
+ * elements with the same label are merged from the start. The rules are
+ * pluggable: a reduction_rule is a name and a function that examines the
+ * kernel once and returns how often it applied; the rules run until none of
+ * them applies anymore
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_reductions_h
+#define cclust_reductions_h
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <cstdlib>
+#include "cclust_labels.h"
+#include "cclust_coassoc.h"
+
+using namespace std;
+
+// instances with more elements are not reduced (the kernel needs n^2 weights)
+#define MAX_REDUCTION_ELEMENTS 2000
+
+class reduction_kernel{
+  uint n;
+  vector<int64_t> weights;        // s(u,v) of the groups with representatives u and v
+  vector<bool> separated;         // u and v are separated for good
+
+public:
+  label_clustering labels;        // the label of each group (at its representative)
+  vector<element_id> parent;      // the representative of the group of each element
+  vector<bool> isolated;          // the group is a cluster of its own
+  vector<element_id> groups;      // the representatives of the groups that are not isolated
+
+  reduction_kernel(const coassociation_matrix& coassoc, const label_clustering& clustering):
+    n(clustering.size()), weights((size_t)n * n, 0), separated((size_t)n * n, false),
+    labels(clustering), parent(n), isolated(n, false)
+  {
+    for(element_id u = 0; u < n; u++){
+      parent[u] = u;
+      for(element_id v = u + 1; v < n; v++){
+        weights[(size_t)u * n + v] = weights[(size_t)v * n + u] =
+          (int64_t)coassoc.count(u, v) - (int64_t)coassoc.anti_count(u, v);
+        if(labels[u] && labels[v] && (labels[u] != labels[v]))
+          separated[(size_t)u * n + v] = separated[(size_t)v * n + u] = true;
+      }
+    }
+    for(element_id u = 0; u < n; u++) groups.push_back(u);
+    // the elements of a cluster of 'clustering' form a group
+    for(element_id u = 0; u < n; u++) if(labels[u])
+      for(element_id v = 0; v < u; v++) if((parent[v] == v) && (labels[v] == labels[u])){
+        merge(u, v);
+        break;
+      }
+  }
+
+  uint num_elements() const { return n; }
+  int64_t weight(const element_id u, const element_id v) const { return weights[(size_t)u * n + v]; }
+  bool is_separated(const element_id u, const element_id v) const { return separated[(size_t)u * n + v]; }
+
+  // return the representative of the group of x
+  element_id find(element_id x) const {
+    while(parent[x] != x) x = parent[x];
+    return x;
+  }
+
+  // merge the group of u into the group of v (both are representatives)
+  void merge(const element_id u, const element_id v){
+    for(vector<element_id>::const_iterator w = groups.begin(); w != groups.end(); w++) if((*w != u) && (*w != v)){
+      weights[(size_t)v * n + *w] = (weights[(size_t)*w * n + v] += weights[(size_t)u * n + *w]);
+      if(separated[(size_t)u * n + *w]) separated[(size_t)v * n + *w] = separated[(size_t)*w * n + v] = true;
+    }
+    if(!labels[v]) labels[v] = labels[u];
+    parent[u] = v;
+    groups.erase(find_if(groups.begin(), groups.end(), [u](const element_id w){ return w == u; }));
+  }
+  // separate the groups u and v for good
+  void separate(const element_id u, const element_id v){
+    separated[(size_t)u * n + v] = separated[(size_t)v * n + u] = true;
+  }
+  // make the group u a cluster of its own
+  void isolate(const element_id u){
+    isolated[u] = true;
+    groups.erase(find_if(groups.begin(), groups.end(), [u](const element_id w){ return w == u; }));
+  }
+};
+
+// a named reduction rule (see above) and the number of times it applied
+class reduction_rule{
+public:
+  string name;
+  uint (*apply)(reduction_kernel& K);
+  uint hits;
+
+  reduction_rule(const string& _name, uint (*_apply)(reduction_kernel&)):
+    name(_name), apply(_apply), hits(0) {}
+};
+
+// merge u into v if s(u,v) >= sum_{w != u,v} |s(u,w)|, that is, 2s(u,v) >= sum_{w != u} |s(u,w)|
+inline uint apply_heavy_edge_rule(reduction_kernel& K){
+  uint hits = 0;
+  for(uint i = 0; i < K.groups.size(); i++){
+    const element_id u = K.groups[i];
+    if(K.labels[u]) continue;
+    int64_t abs_sum = 0;
+    bool free = true;
+    for(vector<element_id>::const_iterator w = K.groups.begin(); w != K.groups.end(); w++) if(*w != u){
+      if(K.is_separated(u, *w)){ free = false; break; }
+      abs_sum += llabs(K.weight(u, *w));
+    }
+    if(!free) continue;
+    for(vector<element_id>::const_iterator v = K.groups.begin(); v != K.groups.end(); v++)
+      if((*v != u) && (2 * K.weight(u, *v) >= abs_sum) && (K.weight(u, *v) > 0)){
+        K.merge(u, *v);
+        hits++;
+        // u is gone, the group at position i is the next one
+        i--;
+        break;
+      }
+  }
+  return hits;
+}
+
+// separate u and v if s(u,v) < 0 and -s(u,v) >= sum_{w != v} max(s(u,w), 0)
+// (the sum leaves out the groups that u is separated from already)
+inline uint apply_heavy_non_edge_rule(reduction_kernel& K){
+  uint hits = 0;
+  for(vector<element_id>::const_iterator u = K.groups.begin(); u != K.groups.end(); u++){
+    int64_t positive_sum = 0;
+    for(vector<element_id>::const_iterator w = K.groups.begin(); w != K.groups.end(); w++)
+      if((*w != *u) && !K.is_separated(*u, *w)) positive_sum += max(K.weight(*u, *w), (int64_t)0);
+    for(vector<element_id>::const_iterator v = K.groups.begin(); v != K.groups.end(); v++)
+      if((*v != *u) && !K.is_separated(*u, *v) && (K.weight(*u, *v) < 0) && (-K.weight(*u, *v) >= positive_sum)){
+        K.separate(*u, *v);
+        hits++;
+      }
+  }
+  return hits;
+}
+
+// isolate u if s(u,w) <= 0 for all w that u is not separated from
+inline uint apply_isolation_rule(reduction_kernel& K){
+  uint hits = 0;
+  for(uint i = 0; i < K.groups.size(); i++){
+    const element_id u = K.groups[i];
+    bool alone = true;
+    for(vector<element_id>::const_iterator w = K.groups.begin(); alone && (w != K.groups.end()); w++)
+      if((*w != u) && !K.is_separated(u, *w) && (K.weight(u, *w) > 0)) alone = false;
+    if(alone){
+      K.isolate(u);
+      hits++;
+      i--;
+    }
+  }
+  return hits;
+}
+
+// the rules in the order they are tried
+inline vector<reduction_rule> get_default_reduction_rules(){
+  vector<reduction_rule> rules;
+  rules.push_back(reduction_rule("heavy edge", apply_heavy_edge_rule));
+  rules.push_back(reduction_rule("heavy non-edge", apply_heavy_non_edge_rule));
+  rules.push_back(reduction_rule("isolation", apply_isolation_rule));
+  return rules;
+}
+
+// apply the rules until none of them applies anymore, counting their hits
+inline void reduce_to_fixpoint(reduction_kernel& K, vector<reduction_rule>& rules,
+                               const bool* cancel_computation = NULL){
+  bool applied = true;
+  while(applied){
+    applied = false;
+    for(vector<reduction_rule>::iterator r = rules.begin(); r != rules.end(); r++){
+      if(cancel_computation)
+        if(*cancel_computation) return;
+      const uint hits = r->apply(K);
+      r->hits += hits;
+      if(hits) applied = true;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,165 @@
+/* This is cclust_relations.h - the relations of the pairs of elements that
+ * the preprocessing works on
+ *
+ * each pair of elements is predominantly co-clustered, predominantly
+ * anti-clustered or dirty. The relation_store keeps one bit per ordered pair
+ * for 'co-clustered' and one for 'dirty' in per-row bitsets, together with
+ * the set of elements that are still active (unclustered) and the number of
+ * active dirty partners of each element. For 10000 elements this needs 25MB
+ * instead of the gigabytes of tree nodes of one set per element and relation
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_relations_h
+#define cclust_relations_h
+
+#include <stdint.h>
+#include <vector>
+#include "cclust_labels.h"
+#include "cclust_coassoc.h"
+#include "cclust_parallel.h"
+
+using namespace std;
+
+enum relation{
+  REL_PRED_COED,    // predominantly co-clusteringed ( >2/3 co )
+  REL_PRED_ANTIED,  // predominantly anti-clusteringed ( <1/3 co )
+  REL_DIRTY,        // dirty (1/3 <= co <= 2/3)
+  REL_UNKNOWN
+};
+
+// return the relation of a pair that is co-clustered by count_coed of m clusterings
+inline relation classify_pair(const uint count_coed, const uint m){
+  if(3 * count_coed < m) return REL_PRED_ANTIED;
+  if(3 * count_coed > 2 * m) return REL_PRED_COED;
+  return REL_DIRTY;
+}
+
+class relation_store{
+  uint n;
+  uint words;                   // 64 bit words per row
+  vector<uint64_t> coed_bits;   // bit y of row x: x and y are predominantly co-clustered
+  vector<uint64_t> dirty_bits;  // bit y of row x: x and y form a dirty pair
+  vector<uint64_t> active_bits; // bit x: x is still active
+  vector<uint> dirty_deg;       // number of active dirty partners
+
+  inline uint64_t* row(vector<uint64_t>& bits, const element_id x) { return &bits[(size_t)x * words]; }
+  inline const uint64_t* row(const vector<uint64_t>& bits, const element_id x) const { return &bits[(size_t)x * words]; }
+  inline static bool test(const uint64_t* bits, const element_id y) { return (bits[y >> 6] >> (y & 63)) & 1; }
+  inline static void put(uint64_t* bits, const element_id y, const bool value){
+    if(value) bits[y >> 6] |= (1ULL << (y & 63)); else bits[y >> 6] &= ~(1ULL << (y & 63));
+  }
+
+  // call f(y) for all active y whose bit is set in row x of 'bits', in increasing order
+  template <typename F>
+  void for_each_active(const vector<uint64_t>& bits, const element_id x, F f) const {
+    const uint64_t* r = row(bits, x);
+    for(uint w = 0; w < words; w++)
+      for(uint64_t word = r[w] & active_bits[w]; word; word &= word - 1)
+        f((element_id)((w << 6) + __builtin_ctzll(word)));
+  }
+
+public:
+  relation_store(): n(0), words(0) {}
+
+  // an empty store of num_elements active elements, where all pairs are
+  // predominantly anti-clustered, except that each element is co-clustered with itself
+  explicit relation_store(const uint num_elements):
+    n(num_elements), words((num_elements + 63) / 64),
+    coed_bits((size_t)n * words, 0), dirty_bits((size_t)n * words, 0),
+    active_bits(words, 0), dirty_deg(n, 0)
+  {
+    for(element_id x = 0; x < n; x++){
+      put(row(coed_bits, x), x, true);
+      put(&active_bits[0], x, true);
+    }
+  }
+
+  uint num_elements() const { return n; }
+
+  // return whether x and y are predominantly coed, antied or dirty
+  relation get_relation(const element_id x, const element_id y) const {
+    if(test(row(coed_bits, x), y)) return REL_PRED_COED;
+    if(test(row(dirty_bits, x), y)) return REL_DIRTY;
+    return REL_PRED_ANTIED;
+  }
+
+  // set x and y (x != y) predominantly coed, antied or dirty (REL_UNKNOWN is antied)
+  void set_relation(const element_id x, const element_id y, const relation r){
+    const bool was_dirty = test(row(dirty_bits, x), y);
+    const bool is_dirty = (r == REL_DIRTY);
+    put(row(coed_bits, x), y, r == REL_PRED_COED);
+    put(row(coed_bits, y), x, r == REL_PRED_COED);
+    put(row(dirty_bits, x), y, is_dirty);
+    put(row(dirty_bits, y), x, is_dirty);
+    if((was_dirty != is_dirty) && is_active(x) && is_active(y)){
+      if(is_dirty){ dirty_deg[x]++; dirty_deg[y]++; } else { dirty_deg[x]--; dirty_deg[y]--; }
+    }
+  }
+
+  // set x and y (x < y) predominantly coed or dirty in row x only, so the rows
+  // can be filled by different threads at the same time, as long as each row is
+  // filled by one thread. complete_upper_relations() has to be called afterwards
+  void set_upper_relation(const element_id x, const element_id y, const relation r){
+    if(r == REL_PRED_COED) put(row(coed_bits, x), y, true);
+    if(r == REL_DIRTY) put(row(dirty_bits, x), y, true);
+  }
+  // copy the relations set by set_upper_relation() to the rows of the larger
+  // elements and count the dirty pairs, row by row on num_threads threads
+  // (the copies are set with an atomic or, since threads of different rows write into the same words,
+  // and the words of row x are read atomically, since the or of a smaller row may hit them meanwhile)
+  void complete_upper_relations(const uint num_threads = 0){
+    parallel_for(0, n, [this](const element_id x){
+      vector<uint64_t>* const all_bits[2] = {&coed_bits, &dirty_bits};
+      for(uint b = 0; b < 2; b++){
+        const uint64_t* r = row(*all_bits[b], x);
+        for(uint w = (x + 1) >> 6; w < words; w++){
+          uint64_t word = __atomic_load_n(&r[w], __ATOMIC_RELAXED);
+          if(w == ((x + 1) >> 6)) word &= ~0ULL << ((x + 1) & 63);
+          for(; word; word &= word - 1){
+            const element_id y = (w << 6) + __builtin_ctzll(word);
+            __atomic_fetch_or(&row(*all_bits[b], y)[x >> 6], 1ULL << (x & 63), __ATOMIC_RELAXED);
+          }
+        }
+      }
+    }, num_threads);
+    parallel_for(0, n, [this](const element_id y){
+      if(!is_active(y)) return;
+      const uint64_t* dirty_y = row(dirty_bits, y);
+      uint deg = 0;
+      for(uint w = 0; w < words; w++) deg += __builtin_popcountll(dirty_y[w] & active_bits[w]);
+      dirty_deg[y] = deg;
+    }, num_threads);
+  }
+
+  bool is_active(const element_id x) const { return test(&active_bits[0], x); }
+
+  // remove x from the relations of all other elements
+  void deactivate(const element_id x){
+    if(!is_active(x)) return;
+    for_each_active(dirty_bits, x, [this](const element_id y){ dirty_deg[y]--; });
+    put(&active_bits[0], x, false);
+    dirty_deg[x] = 0;
+  }
+
+  // the number of dirty pairs of x with active elements
+  uint dirty_degree(const element_id x) const { return dirty_deg[x]; }
+
+  // compute the number of dirty pairs related to the given elements
+  uint num_dirty_pairs(const vector<element_id>& elements) const {
+    uint dirty_pairs = 0;
+    for(vector<element_id>::const_iterator x = elements.begin(); x != elements.end(); x++)
+      dirty_pairs += dirty_deg[*x];
+    return dirty_pairs;
+  }
+
+  // call f(y) for all active y that are predominantly co-clustered with x (including x)
+  template <typename F>
+  void for_each_coed(const element_id x, F f) const { for_each_active(coed_bits, x, f); }
+  // call f(y) for all active y that form a dirty pair with x
+  template <typename F>
+  void for_each_dirty(const element_id x, F f) const { for_each_active(dirty_bits, x, f); }
+};
+
+#endif
@@ -0,0 +1,338 @@
+/* This is cclust_search.h - a branch-and-bound search for an optimal
+ * consensus clustering
+ *
+ * the unclustered elements are put into clusters one after the other, as in
+ * the brute force search of cclust.h, but a subtree is skipped as soon as the
+ * distance accumulated so far plus a lower bound on the distance of the
+ * undecided pairs reaches the best clustering known (the incumbent).
+ * The incumbent is seeded by a greedy heuristic and a few runs of the
+ * heuristics of cclust_heuristics.h.
+ * The lower bound is the sum over all undecided pairs {x,y} of
+ * min(co(x,y), m - co(x,y)) plus, for a set of pair-disjoint conflict
+ * triples, the least excess any clustering pays on each triple
+ *
+ * the search can run on several threads of a work_stealing_pool: a worker
+ * hands subtrees to the pool while other workers are idle, and all workers
+ * prune against the same (atomic) cost of the incumbent
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_search_h
+#define cclust_search_h
+
+#include <vector>
+#include <algorithm>
+#include "cclust_labels.h"
+#include "cclust_coassoc.h"
+#include "cclust_parallel.h"
+#include "cclust_heuristics.h"
+
+using namespace std;
+
+// if there are more unclustered elements, the conflict triples are not packed
+#define MAX_TRIPLE_PACKING_ELEMENTS 500
+// subtrees with less unclustered elements are not handed to other workers
+#define MIN_TASK_ELEMENTS 6
+// the number of runs of the pivot heuristic with local search that seed the incumbent
+#define SEED_HEURISTIC_RUNS 8
+// the progress is counted in units of 2^-40
+#define PROGRESS_UNITS ((double)(1ULL << 40))
+
+// the least distance any clustering has on the pair {x,y}
+inline uint64_t get_pair_bound(const coassociation_matrix& coassoc, const element_id x, const element_id y){
+  return min(coassoc.count(x, y), coassoc.anti_count(x, y));
+}
+
+// the distance a clustering pays on the pair {x,y} on top of the bound above
+// if it does not follow the majority of the clusterings
+inline uint64_t get_pair_excess(const coassociation_matrix& coassoc, const element_id x, const element_id y){
+  const uint64_t c = coassoc.count(x, y), a = coassoc.anti_count(x, y);
+  return (c > a) ? c - a : a - c;
+}
+
+// return whether the majority of the clusterings co-clusters x and y
+inline bool pred_coed(const coassociation_matrix& coassoc, const element_id x, const element_id y){
+  return coassoc.count(x, y) > coassoc.anti_count(x, y);
+}
+
+// for each unclustered element x, compute the change of the accumulated
+// distance of C (restricted to clustered elements) when x joins cluster c,
+// for all c in 1...max_label+1, into costs[c]
+inline void get_assignment_costs(const coassociation_matrix& coassoc, const label_clustering& C,
+                                 const element_id x, const uint32_t max_label,
+                                 uint64_t* costs){
+  // x pays co(x,y) for all clustered y outside its cluster and m-co(x,y) inside
+  uint64_t all_coed = 0;
+  fill(costs, costs + max_label + 2, 0);
+  for(element_id y = 0; y < C.size(); y++)
+    if(C[y] && (y != x)){
+      const uint64_t c = coassoc.count(x, y);
+      all_coed += c;
+      costs[C[y]] += coassoc.anti_count(x, y) - c;
+    }
+  for(uint32_t c = 1; c <= max_label + 1; c++) costs[c] += all_coed;
+}
+inline void get_assignment_costs(const coassociation_matrix& coassoc, const label_clustering& C,
+                                 const element_id x, const uint32_t max_label,
+                                 vector<uint64_t>& costs){
+  costs.resize(max_label + 2);
+  get_assignment_costs(coassoc, C, x, max_label, &costs[0]);
+}
+
+// complete C greedily: put each unclustered element (in the order of their ids)
+// into the cluster that increases the accumulated distance least,
+// return the accumulated distance on all pairs
+inline uint64_t get_greedy_completion(const coassociation_matrix& coassoc, label_clustering& C){
+  uint32_t max_label = 0;
+  for(element_id x = 0; x < C.size(); x++) max_label = max(max_label, C[x]);
+  // the accumulated distance on the pairs that are already clustered
+  uint64_t cost = 0;
+  for(element_id x = 0; x < C.size(); x++) if(C[x])
+    for(element_id y = x + 1; y < C.size(); y++) if(C[y])
+      cost += coed(x, y, C) ? coassoc.anti_count(x, y) : coassoc.count(x, y);
+
+  vector<uint64_t> costs;
+  for(element_id x = 0; x < C.size(); x++) if(!C[x]){
+    get_assignment_costs(coassoc, C, x, max_label, costs);
+    uint32_t best = 1;
+    for(uint32_t c = 2; c <= max_label + 1; c++)
+      if(costs[c] < costs[best]) best = c;
+    C[x] = best;
+    cost += costs[best];
+    max_label = max(max_label, best);
+  }
+  return cost;
+}
+
+
+// a subtree of the search that is handed to another worker
+class bnb_task{
+public:
+  label_clustering current;
+  uint depth;
+  uint32_t max_label;
+  uint64_t cost;
+  uint64_t pair_bound;
+  double share;           // the share of the subtree in the whole search tree
+};
+
+// the state of a branch-and-bound search, shared by all workers
+class bnb_state{
+public:
+  const coassociation_matrix* coassoc;
+  vector<element_id> order;       // the unclustered elements in the order they are branched on
+  vector<uint64_t> triple_bound;  // triple_bound[d]: bound of the triples still intact at depth d
+  bool use_bounds;                // if unset, only the cost so far is compared to the incumbent
+
+  // the incumbent, its cost can be read without locking best_mutex
+  atomic<uint64_t> best_cost;
+  mutex best_mutex;
+  label_clustering best;
+
+  atomic<uint64_t> searched;      // the share of the tree searched or skipped so far
+  double* progress_pc;
+  const bool* cancel_computation;
+
+  work_stealing_pool<bnb_task>* pool;   // NULL if the search is sequential
+
+  // buffers of each worker for the options of each depth and for the costs
+  // they are sorted from (which are only needed before branching), so the
+  // nodes do not allocate
+  uint row_size;
+  vector<vector<uint64_t> > costs;
+  vector<vector<pair<uint64_t, uint32_t> > > options;
+};
+
+// account for a searched or skipped subtree
+inline void add_progress(bnb_state& S, const double share){
+  const uint64_t searched = (S.searched += (uint64_t)(share * PROGRESS_UNITS));
+  if(S.progress_pc) *S.progress_pc = searched / PROGRESS_UNITS;
+}
+
+// pack pair-disjoint conflict triples among the elements in S.order greedily
+// a triple is in conflict if the majority co-clusters exactly two of its pairs,
+// then each clustering has to go against the majority on one of the three pairs
+// a triple only adds to the bound while at most one of its elements is clustered,
+// that is, up to the depth at which its second element (in S.order) is branched on
+inline void pack_conflict_triples(bnb_state& S){
+  const coassociation_matrix& coassoc = *S.coassoc;
+  const uint k = S.order.size();
+  S.triple_bound.assign(k + 2, 0);
+  if(!S.use_bounds || (k > MAX_TRIPLE_PACKING_ELEMENTS)) return;
+
+  // used[a * k + b] is set if the pair of order[a] and order[b] is in a packed triple
+  vector<bool> used((size_t)k * k, false);
+  for(uint a = 0; a < k; a++)
+    for(uint b = a + 1; b < k; b++) if(!used[(size_t)a * k + b])
+      for(uint c = b + 1; c < k; c++) if(!used[(size_t)a * k + c] && !used[(size_t)b * k + c]){
+        const element_id x = S.order[a], y = S.order[b], z = S.order[c];
+        const uint num_coed = pred_coed(coassoc, x, y) + pred_coed(coassoc, x, z) + pred_coed(coassoc, y, z);
+        if(num_coed != 2) continue;
+        const uint64_t excess = min(get_pair_excess(coassoc, x, y),
+            min(get_pair_excess(coassoc, x, z), get_pair_excess(coassoc, y, z)));
+        if(!excess) continue;
+        used[(size_t)a * k + b] = used[(size_t)a * k + c] = used[(size_t)b * k + c] = true;
+        // the triple is intact up to (and including) depth b
+        S.triple_bound[b] += excess;
+        break;
+      }
+  // accumulate from the back: triple_bound[d] = sum of the triples intact at depth d
+  for(uint d = k + 1; d > 0; d--) S.triple_bound[d - 1] += S.triple_bound[d];
+}
+
+// one node of the branch-and-bound search: put S.order[depth] into each of the
+// clusters 1...max_label+1 (cheapest first) and branch, unless the subtree
+// cannot contain a clustering that is better than the incumbent
+// 'cost' is the accumulated distance on the clustered pairs and 'pair_bound'
+// the sum of the pair bounds of all undecided pairs
+// if other workers are idle, subtrees are pushed to the pool instead of searched
+inline void bnb_branch(bnb_state& S, const uint worker, label_clustering& current,
+                       const uint depth, const uint32_t max_label,
+                       const uint64_t cost, const uint64_t pair_bound,
+                       const double share){
+  if(S.cancel_computation)
+    if(*S.cancel_computation) return;
+  if(depth == S.order.size()){
+    if(cost < S.best_cost){
+      lock_guard<mutex> lock(S.best_mutex);
+      if(cost < S.best_cost){
+        S.best_cost = cost;
+        S.best = current;
+      }
+    }
+    add_progress(S, share);
+    return;
+  }
+  const coassociation_matrix& coassoc = *S.coassoc;
+  const element_id x = S.order[depth];
+
+  // clustering x decides the pairs of x and the clustered elements
+  uint64_t child_pair_bound = 0, child_bound = 0;
+  if(S.use_bounds){
+    uint64_t decided_bound = 0;
+    for(element_id y = 0; y < current.size(); y++)
+      if(current[y]) decided_bound += get_pair_bound(coassoc, x, y);
+    child_pair_bound = pair_bound - decided_bound;
+    child_bound = child_pair_bound + S.triple_bound[depth + 1];
+  }
+
+  uint64_t* const costs = &S.costs[worker][0];
+  get_assignment_costs(coassoc, current, x, max_label, costs);
+  pair<uint64_t, uint32_t>* const options = &S.options[worker][(size_t)depth * S.row_size];
+  const uint num_options = max_label + 1;
+  for(uint32_t c = 1; c <= num_options; c++)
+    options[c - 1] = pair<uint64_t, uint32_t>(costs[c], c);
+  sort(options, options + num_options);
+
+  const double step = share/num_options;
+  const bool may_split = S.pool && (S.order.size() - depth > MIN_TASK_ELEMENTS);
+  uint o = 0;
+  for(; o < num_options; o++){
+    // the options are sorted, so no later option can beat the incumbent either
+    if(cost + options[o].first + child_bound >= S.best_cost) break;
+    current[x] = options[o].second;
+    // the cheapest option is always searched here, the others may be handed off
+    if(may_split && o && S.pool->hungry()){
+      bnb_task task;
+      task.current = current;
+      task.depth = depth + 1;
+      task.max_label = max(max_label, options[o].second);
+      task.cost = cost + options[o].first;
+      task.pair_bound = child_pair_bound;
+      task.share = step;
+      S.pool->push(worker, task);
+    } else
+      bnb_branch(S, worker, current, depth + 1, max(max_label, options[o].second),
+                 cost + options[o].first, child_pair_bound, step);
+    current[x] = 0;
+  }
+  // the remaining options were skipped
+  add_progress(S, step * (num_options - o));
+}
+
+// complete the given (partial) clustering to a clustering of minimum accumulated
+// distance to all clusterings in coassoc using branch-and-bound (see above)
+// on num_threads threads (0 = one per core), if use_bounds is unset, subtrees
+// are only skipped if their cost so far reaches the incumbent
+inline label_clustering get_consensus_clustering_bnb(const coassociation_matrix& coassoc,
+                                                     label_clustering current_clustering = label_clustering(),
+                                                     double* progress_pc = NULL,
+                                                     const bool* cancel_computation = NULL,
+                                                     const uint num_threads = 1,
+                                                     const bool use_bounds = true){
+  if(cancel_computation)
+    if(*cancel_computation) return label_clustering();
+  // if the current_clustering is new, set all items to unclustered
+  if(current_clustering.empty()){
+    if(!coassoc.empty())
+      current_clustering = label_clustering(coassoc.num_elements());
+    else return current_clustering;
+  }
+
+  bnb_state S;
+  S.coassoc = &coassoc;
+  S.order = get_unclustered_elements(current_clustering);
+  S.use_bounds = use_bounds;
+  S.searched = 0;
+  S.progress_pc = progress_pc;
+  S.cancel_computation = cancel_computation;
+  S.pool = NULL;
+
+  // seed the incumbent
+  S.best = current_clustering;
+  S.best_cost = get_greedy_completion(coassoc, S.best);
+  {
+    const label_clustering seed = get_consensus_clustering_heuristic(coassoc, current_clustering,
+        HEURISTIC_LOCAL_SEARCH, SEED_HEURISTIC_RUNS, NULL, cancel_computation, NULL, 1);
+    const uint64_t seed_cost = get_accumulated_distance(coassoc, seed);
+    if(seed_cost < S.best_cost){
+      S.best = seed;
+      S.best_cost = seed_cost;
+    }
+  }
+
+  uint32_t max_label = 0;
+  uint64_t cost = 0, pair_bound = 0;
+  for(element_id x = 0; x < current_clustering.size(); x++){
+    max_label = max(max_label, current_clustering[x]);
+    for(element_id y = x + 1; y < current_clustering.size(); y++)
+      if(current_clustering[x] && current_clustering[y])
+        cost += coed(x, y, current_clustering) ? coassoc.anti_count(x, y) : coassoc.count(x, y);
+      else if(use_bounds)
+        pair_bound += get_pair_bound(coassoc, x, y);
+  }
+  pack_conflict_triples(S);
+
+  // the labels used at depth d are at most max_label + d + 1
+  const uint workers = num_worker_threads(num_threads);
+  S.row_size = max_label + S.order.size() + 2;
+  S.costs.assign(workers, vector<uint64_t>(S.row_size));
+  S.options.assign(workers, vector<pair<uint64_t, uint32_t> >((S.order.size() + 1) * (size_t)S.row_size));
+
+  if(workers == 1)
+    bnb_branch(S, 0, current_clustering, 0, max_label, cost, pair_bound, 1);
+  else {
+    work_stealing_pool<bnb_task> pool(workers);
+    S.pool = &pool;
+    bnb_task root;
+    root.current = current_clustering;
+    root.depth = 0;
+    root.max_label = max_label;
+    root.cost = cost;
+    root.pair_bound = pair_bound;
+    root.share = 1;
+    pool.push(0, root);
+    pool.run([&S](bnb_task& task, const uint worker){
+      bnb_branch(S, worker, task.current, task.depth, task.max_label,
+                 task.cost, task.pair_bound, task.share);
+    });
+  }
+
+  if(cancel_computation)
+    if(*cancel_computation) return label_clustering();
+  if(progress_pc) *progress_pc = 1;
+  return S.best;
+}
+
+#endif
@@ -0,0 +1,159 @@
+/* This is cclust_subset_dp.h - an exact dynamic program over subsets for
+ * small instances
+ *
+ * the elements of each cluster of the given clustering form one unit, and so
+ * does each unclustered element. The accumulated distance of a clustering is
+ * the sum of all counts plus, for each pair in a common cluster, its anti-count
+ * minus its count, so it suffices to minimize the sum of the cluster costs
+ * w(S) = sum_{u < v in S} (anti(u,v) - count(u,v)) over all partitions of the
+ * units in which no cluster contains two units of different clusters.
+ * w is precomputed for all 2^k subsets of units, then the best partition of
+ * each subset S is the best partition of S minus a cluster containing the
+ * least unit of S, plus that cluster. This takes O(3^k) time and O(2^k) space
+ * independently of the input, which beats enumerating partitions as soon as k
+ * exceeds a handful of units
+ *
+ * author of this file is Mathias Weller <mathias.weller@uni-jena.de>
+ */
+
+#ifndef cclust_subset_dp_h
+#define cclust_subset_dp_h
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdint.h>
+#include <type_traits>
+#include "cclust_labels.h"
+#include "cclust_coassoc.h"
+
+using namespace std;
+
+// instances with more units are left to the search (the time grows with 3^k)
+#ifndef SUBSET_DP_MAX_ELEMENTS
+#define SUBSET_DP_MAX_ELEMENTS 16
+#endif
+// the number of subsets after which progress and cancellation are checked
+#define SUBSET_DP_CHECK_INTERVAL 4096
+
+// a set of units, in the smallest type that holds SUBSET_DP_MAX_ELEMENTS bits
+typedef conditional<(SUBSET_DP_MAX_ELEMENTS <= 32), uint32_t, uint64_t>::type subset_mask;
+
+// return the number of units of the clustering (see above)
+inline uint get_num_units(const label_clustering& current_clustering){
+  map<uint32_t, bool> labels;
+  uint units = 0;
+  for(label_clustering::const_iterator l = current_clustering.begin(); l != current_clustering.end(); l++)
+    if(!*l) units++;
+    else if(labels.insert(pair<uint32_t, bool>(*l, true)).second) units++;
+  return units;
+}
+
+// complete the given (partial) clustering to a clustering of minimum accumulated
+// distance to all clusterings in coassoc, using the dynamic program above
+// the instance may have at most SUBSET_DP_MAX_ELEMENTS units, if the computation
+// is canceled, the result is empty
+inline label_clustering get_consensus_clustering_subset_dp(const coassociation_matrix& coassoc,
+                                                           label_clustering current_clustering = label_clustering(),
+                                                           double* progress_pc = NULL,
+                                                           const bool* cancel_computation = NULL){
+  // if the current_clustering is new, set all items to unclustered
+  if(current_clustering.empty()){
+    if(!coassoc.empty())
+      current_clustering = label_clustering(coassoc.num_elements());
+    else return current_clustering;
+  }
+  const uint n = current_clustering.size();
+
+  // the units and the clustered ones among them
+  vector<uint> unit_of(n);
+  vector<uint32_t> unit_label;
+  map<uint32_t, uint> unit_of_label;
+  for(element_id x = 0; x < n; x++){
+    const uint32_t l = current_clustering[x];
+    if(l){
+      map<uint32_t, uint>::const_iterator u = unit_of_label.find(l);
+      if(u == unit_of_label.end())
+        u = unit_of_label.insert(pair<uint32_t, uint>(l, unit_label.size())).first;
+      if(u->second == unit_label.size()) unit_label.push_back(l);
+      unit_of[x] = u->second;
+    } else {
+      unit_of[x] = unit_label.size();
+      unit_label.push_back(0);
+    }
+  }
+  const uint k = unit_label.size();
+  if(k > SUBSET_DP_MAX_ELEMENTS) return label_clustering();
+  subset_mask clustered = 0;
+  for(uint u = 0; u < k; u++) if(unit_label[u]) clustered |= (subset_mask)1 << u;
+
+  // the cost of co-clustering two units
+  vector<int64_t> pair_cost((size_t)k * k, 0);
+  for(element_id x = 0; x < n; x++)
+    for(element_id y = x + 1; y < n; y++) if(unit_of[x] != unit_of[y]){
+      const int64_t c = (int64_t)coassoc.anti_count(x, y) - (int64_t)coassoc.count(x, y);
+      pair_cost[(size_t)unit_of[x] * k + unit_of[y]] += c;
+      pair_cost[(size_t)unit_of[y] * k + unit_of[x]] += c;
+    }
+
+  // the cost of each subset as a cluster, built from the subset without its least unit
+  const size_t subsets = (size_t)1 << k;
+  vector<int64_t> cluster_cost(subsets, 0);
+  for(size_t S = 1; S < subsets; S++){
+    const uint u = __builtin_ctzll(S);
+    int64_t c = cluster_cost[S & (S - 1)];
+    for(subset_mask rest = (subset_mask)(S & (S - 1)); rest; rest &= rest - 1)
+      c += pair_cost[(size_t)u * k + __builtin_ctzll(rest)];
+    cluster_cost[S] = c;
+  }
+
+  // best[S] is the least cost of a partition of S, whose cluster containing
+  // the least unit of S is first[S]
+  vector<int64_t> best(subsets, 0);
+  vector<subset_mask> first(subsets, 0);
+  for(size_t S = 1; S < subsets; S++){
+    if((S % SUBSET_DP_CHECK_INTERVAL) == 0){
+      if(cancel_computation)
+        if(*cancel_computation) return label_clustering();
+      if(progress_pc) *progress_pc = (double)S / subsets;
+    }
+    const subset_mask least = (subset_mask)(S & (~S + 1));
+    const subset_mask rest = (subset_mask)S ^ least;
+    // a cluster may contain at most one clustered unit
+    const subset_mask others = (least & clustered) ? (rest & ~clustered) : rest;
+    int64_t best_S = INT64_MAX;
+    subset_mask first_S = least;
+    for(subset_mask T = others;; T = (T - 1) & others){
+      if(__builtin_popcountll(T & clustered) <= 1){
+        const subset_mask C = T | least;
+        const int64_t c = cluster_cost[C] + best[S ^ C];
+        if(c < best_S){
+          best_S = c;
+          first_S = C;
+        }
+      }
+      if(!T) break;
+    }
+    best[S] = best_S;
+    first[S] = first_S;
+  }
+
+  // the clusters of the best partition of all units, clusters with a clustered unit keep its label
+  uint32_t next_label = 1;
+  for(uint u = 0; u < k; u++) next_label = max(next_label, unit_label[u] + 1);
+  vector<uint32_t> label_of_unit(k, 0);
+  for(subset_mask S = (subset_mask)(subsets - 1); S; S ^= first[S]){
+    const subset_mask C = first[S];
+    uint32_t label = 0;
+    for(subset_mask rest = C; rest; rest &= rest - 1)
+      if(unit_label[__builtin_ctzll(rest)]) label = unit_label[__builtin_ctzll(rest)];
+    if(!label) label = next_label++;
+    for(subset_mask rest = C; rest; rest &= rest - 1) label_of_unit[__builtin_ctzll(rest)] = label;
+  }
+  label_clustering result(n);
+  for(element_id x = 0; x < n; x++) result[x] = label_of_unit[unit_of[x]];
+  if(progress_pc) *progress_pc = 1.0;
+  return result;
+}
+
+#endif
@@ -26,7 +26,7 @@ void edit_clusterings_window::connect_my_signals(){
   btnCancel->signal_clicked().connect(sigc::mem_fun(*this, &edit_clusterings_window::on_btnCancel_clicked));
 }
 
-edit_clusterings_window::edit_clusterings_window(vector<clustering<std::string> > *_clusterings):clusterings(*_clusterings){
+edit_clusterings_window::edit_clusterings_window(vector<clustering<std::string> > *_clusterings):clusterings(*_clusterings),distances_thread(NULL){
   // create Gtk window using Gtk::Builder
   Glib::RefPtr<Gtk::Builder> builder = Gtk::Builder::create();
 
@@ -52,6 +52,10 @@ edit_clusterings_window::edit_clusterings_window(vector<clustering<std::string>
 
   tvClusterings->set_model(pClusteringsList);
   tvClusterings->append_column("Clustering", model_Columns_clusterings.m_col_text);
+  tvClusterings->append_column("sum of distances", model_Columns_clusterings.m_col_distance);
+
+  signal_distances_progress.connect(sigc::mem_fun(*this, &edit_clusterings_window::update_distances));
+  signal_distances_done.connect(sigc::mem_fun(*this, &edit_clusterings_window::update_distances));
 
   pItemList = Gtk::ListStore::create(model_Columns_items);
   tvItems->set_model(pItemList);
@@ -73,6 +77,10 @@ edit_clusterings_window::edit_clusterings_window(vector<clustering<std::string>
     tvClusterings->get_selection()->select(iter);
 }
 
+edit_clusterings_window::~edit_clusterings_window(){
+  stop_distances();
+}
+
 vector<clustering<std::string> > edit_clusterings_window::get_clusterings() const{
   return clusterings;
 }
@@ -87,6 +95,8 @@ void edit_clusterings_window::update_tvClusterings(const bool update_items){
     old_selection = pClusteringsList->get_string(iter);
     DEBUG("got clustering selection " << old_selection << std::endl);
   }
+  // the distance thread reads the clusterings, stop it before they change
+  stop_distances();
   // clear all rows
   pClusteringsList->clear();
   // redisplay all clusterings
@@ -99,6 +109,7 @@ void edit_clusterings_window::update_tvClusterings(const bool update_items){
     s.str(std::string());
     s << *i;
     row[model_Columns_clusterings.m_col_text] = s.str();
+    row[model_Columns_clusterings.m_col_distance] = "?";
     row[model_Columns_clusterings.m_col_clustering] = &(*i);
   }
   DEBUG("done updating" << std::endl);
@@ -110,6 +121,48 @@ void edit_clusterings_window::update_tvClusterings(const bool update_items){
     // if the clusterings changed, then the consensus has to be recalculated
   }
   if(update_items) update_tvItems();
+  start_distances();
+}
+
+// compute the distances between the clusterings in the background
+void edit_clusterings_window::start_distances(){
+  stop_distances();
+  distinct_clusterings = weighted_clusterings(to_label_clusterings(clusterings, make_element_dictionary(clusterings)));
+  if(distinct_clusterings.total()){
+    distances_thread = new distances_cclust_thread(&distinct_clusterings,
+        &signal_distances_progress, &signal_distances_done);
+    distances_thread->start();
+  }
+}
+
+// cancel the distance computation (if running) and wait for it
+void edit_clusterings_window::stop_distances(){
+  if(distances_thread){
+    distances_thread->cancel();
+    distances_thread->wait();
+    delete distances_thread;
+    distances_thread = NULL;
+  }
+}
+
+// show the (partial) sums of distances of the clusterings
+void edit_clusterings_window::update_distances(){
+  if(!distances_thread) return;
+  const std::vector<uint64_t> sums = distances_thread->get_sums();
+  const bool complete = distances_thread->is_complete();
+  // the thread did not start yet
+  if(sums.size() != clusterings.size()) return;
+
+  std::stringstream s;
+  uint i = 0;
+  Gtk::TreeModel::Children rows = pClusteringsList->children();
+  for(Gtk::TreeModel::Children::iterator row = rows.begin(); row != rows.end(); row++, i++){
+    s.str(std::string());
+    // partial sums are lower bounds
+    if(!complete) s << ">=";
+    s << sums[i];
+    (*row)[model_Columns_clusterings.m_col_distance] = s.str();
+  }
 }
 
 void edit_clusterings_window::update_tvItems(){
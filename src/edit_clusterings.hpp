@@ -9,10 +9,11 @@
 class edit_clusterings_window{
   // treeview stuff
   class ClusteringColumns : public Gtk::TreeModel::ColumnRecord{
-    // TODO: add a "distance" column
   	public:
-  	ClusteringColumns(){ add(m_col_text); add(m_col_clustering);}
+  	ClusteringColumns(){ add(m_col_text); add(m_col_distance); add(m_col_clustering);}
   	Gtk::TreeModelColumn<std::string> m_col_text;
+    // the sum of distances to all other clusterings
+  	Gtk::TreeModelColumn<std::string> m_col_distance;
     // this is hidden data, because it is not being added as a view column
   	Gtk::TreeModelColumn<clustering<std::string>* > m_col_clustering;
   };
@@ -37,6 +38,16 @@ class edit_clusterings_window{
   void update_tvClusterings(const bool update_items=true);
   void update_tvItems();
 
+  // the distances between the clusterings are computed in the background
+  // on the dense representation of the clusterings
+  weighted_clusterings distinct_clusterings;
+  distances_cclust_thread *distances_thread;
+  Glib::Dispatcher signal_distances_progress;
+  Glib::Dispatcher signal_distances_done;
+  void start_distances();
+  void stop_distances();
+  void update_distances();
+
 
   // ========== window elements we use ==================
   public:
@@ -69,6 +80,7 @@ class edit_clusterings_window{
   public:
     // constructors & destructors
     edit_clusterings_window(std::vector<clustering<std::string> >* _clustering);
+    ~edit_clusterings_window();
 
 };
 
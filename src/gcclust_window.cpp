@@ -50,6 +50,12 @@ void gcclust_window::get_my_elements(Glib::RefPtr<Gtk::Builder> builder){
   builder->get_widget("consensus_save1", consensus_save1);
   builder->get_widget("consensus_save_as1", consensus_save_as1);
   builder->get_widget("brute_force_search1", brute_force_search1);
+  builder->get_widget("branch_and_bound1", branch_and_bound1);
+  builder->get_widget("average_parameterized1", average_parameterized1);
+  builder->get_widget("parallel_search1", parallel_search1);
+  builder->get_widget("heuristic_search1", heuristic_search1);
+  builder->get_widget("local_search1", local_search1);
+  builder->get_widget("best_input1", best_input1);
   builder->get_widget("compute_consensus1", compute_consensus1);
 }
 
@@ -82,21 +88,32 @@ gcclust_window::gcclust_window() : timer_thread(100, &signal_progress_pc){
   pClusteringsList = Gtk::ListStore::create(model_Columns_clusterings);
   tvClusterings->set_model(pClusteringsList);
   tvClusterings->append_column("Clustering", model_Columns_clusterings.m_col_text);
+  tvClusterings->append_column("sum of distances", model_Columns_clusterings.m_col_distance);
 
   pConsensusList = Gtk::ListStore::create(model_Columns_clusterings);
   tvConsensus->set_model(pConsensusList);
   tvConsensus->append_column("Consensus", model_Columns_clusterings.m_col_text);
+  tvConsensus->append_column("sum of distances", model_Columns_clusterings.m_col_distance);
 
   lblClusteringsFrame->set_label("input Clusterings (average distance: ...)");
 
   // connect the progress bar update routine to the appropriate dispatcher
   signal_progress_pc.connect(sigc::mem_fun(*this, &gcclust_window::update_percent));
+  // show the distances between the input clusterings as they come in
+  signal_distances_progress.connect(sigc::mem_fun(*this, &gcclust_window::update_distances));
+  signal_distances_done.connect(sigc::mem_fun(*this, &gcclust_window::update_distances));
 
   // time measurement
   measure_time = measure_time1->get_active();
   // threading
   preprocess_thread = NULL;
   searchtree_thread = NULL;
+  heuristic_thread = NULL;
+  medoid_thread = NULL;
+  heuristic_running = false;
+  distances_thread = NULL;
+  // input
+  binary_input = NULL;
   // misc stuff
   cancel1->set_sensitive(false);
   // this will automtically update the tvConsensus as well
@@ -104,8 +121,12 @@ gcclust_window::gcclust_window() : timer_thread(100, &signal_progress_pc){
 }
 
 gcclust_window::~gcclust_window(){
+  stop_distances();
   if(preprocess_thread) delete preprocess_thread;
   if(searchtree_thread) delete searchtree_thread;
+  if(heuristic_thread) delete heuristic_thread;
+  if(medoid_thread) delete medoid_thread;
+  delete binary_input;
   // TODO: delete the builder
 }
 
@@ -127,6 +148,17 @@ std::string gcclust_window::select_a_file(const std::string caption, const Gtk::
   filter_text.add_mime_type("text/plain");
   dialog.add_filter(filter_text);
 
+  Gtk::FileFilter filter_binary;
+  filter_binary.set_name("Binary clusterings");
+  filter_binary.add_pattern("*" BINARY_CLUSTERINGS_EXTENSION);
+  dialog.add_filter(filter_binary);
+
+  Gtk::FileFilter filter_compressed;
+  filter_compressed.set_name("Compressed files");
+  filter_compressed.add_pattern("*.gz");
+  filter_compressed.add_pattern("*.zst");
+  dialog.add_filter(filter_compressed);
+
   // Show the dialog and wait for a user response:
   int result = dialog.run();
 
@@ -148,39 +180,98 @@ std::string gcclust_window::select_a_file(const std::string caption, const Gtk::
 
 }
 
-// when idle, calculate the average distance of the input clusterings,
-// if they are less then 200 clusterings and less than 200 elements
-bool gcclust_window::calc_avg_dist_when_idle(){
-  if(clusterings.size() && (clusterings.size()<200) && (clusterings.begin()->size()<200)){
-    DEBUG("we are idle, lets calc avg distances (" << clusterings.size() << " clusterings, " << clusterings.begin()->size() << "elements)..." << std::endl);
-    stringstream s;
-    s.precision(4);
-    s << "input Clusterings (average distance: " << get_avg_distance(clusterings) << ")";
-    lblClusteringsFrame->set_label(s.str());
-    // remove the signal handler
+// compute the distances between the input clusterings in the background
+void gcclust_window::start_distances(){
+  stop_distances();
+  if(distinct_clusterings.total()){
+    DEBUG("computing distances (" << distinct_clusterings.total() << " clusterings, " << elements.size() << " elements)..." << std::endl);
+    distances_thread = new distances_cclust_thread(&distinct_clusterings,
+        &signal_distances_progress, &signal_distances_done);
+    distances_thread->start();
+  }
+}
+
+// cancel the distance computation (if running) and wait for it
+void gcclust_window::stop_distances(){
+  if(distances_thread){
+    distances_thread->cancel();
+    distances_thread->wait();
+    delete distances_thread;
+    distances_thread = NULL;
+  }
+}
+
+// show the (partial) sums of distances of the input clusterings
+// and the average distance, once all distances are known
+void gcclust_window::update_distances(){
+  if(!distances_thread) return;
+  const std::vector<uint64_t> sums = distances_thread->get_sums();
+  const bool complete = distances_thread->is_complete();
+  // the thread did not start yet
+  if(sums.size() != distinct_clusterings.total()) return;
+
+  std::stringstream s;
+  uint64_t accu = 0;
+  uint i = 0;
+  Gtk::TreeModel::Children rows = pClusteringsList->children();
+  for(Gtk::TreeModel::Children::iterator row = rows.begin(); row != rows.end(); row++, i++){
+    s.str(std::string());
+    // partial sums are lower bounds
+    if(!complete) s << ">=";
+    s << sums[distinct_clusterings.first[i]];
+    (*row)[model_Columns_clusterings.m_col_distance] = s.str();
   }
-  return false;
+  for(std::vector<uint64_t>::const_iterator j = sums.begin(); j != sums.end(); j++) accu += *j;
+
+  s.str(std::string());
+  s.precision(4);
+  if(complete)
+    s << "input Clusterings (average distance: " << ((double)accu)/sums.size() << ")";
+  else
+    s << "input Clusterings (average distance: computing, " << 100*distances_thread->get_progress() << "%)";
+  lblClusteringsFrame->set_label(s.str());
 }
 
-void gcclust_window::update_tvClusterings(){
+void gcclust_window::update_tvClusterings(const bool update_labels){
   std::stringstream s;
+  // the distance thread reads the clusterings, stop it before they change
+  stop_distances();
   // clear all rows
   pClusteringsList->clear();
 
-  // redisplay all clusterings
-  for(vector<clustering<std::string> >::const_iterator i = clusterings.begin();
-      i != clusterings.end(); i++){
+  // give ids to the elements and translate the clusterings once
+  // (unless they were read in the dense representation)
+  if(update_labels){
+    delete binary_input;
+    binary_input = NULL;
+    elements = make_element_dictionary(clusterings);
+    label_clusterings = to_label_clusterings(clusterings, elements);
+    distinct_clusterings = weighted_clusterings(label_clusterings);
+  }
+  coassoc = coassociation_matrix();
+
+  // only the distinct clusterings are translated back to names
+  shown_clusterings.clear();
+  for(uint i = 0; i < distinct_clusterings.size(); i++)
+    shown_clusterings.push_back(to_clustering(distinct_clusterings.clusterings[i], elements));
+
+  // redisplay all distinct clusterings, repeated ones with their multiplicity
+  for(uint i = 0; i < distinct_clusterings.size(); i++){
+    const clustering<std::string>& C = shown_clusterings[i];
     // add row
     Gtk::TreeModel::Row row = *(pClusteringsList->append());
 
     // set values
     s.str(std::string());
-    s << *i;
+    s << C;
+    if(distinct_clusterings.multiplicities[i] > 1)
+      s << " \u00d7" << distinct_clusterings.multiplicities[i];
     row[model_Columns_clusterings.m_col_text] = s.str();
-    row[model_Columns_clusterings.m_col_clustering] = &(*i);
+    row[model_Columns_clusterings.m_col_distance] = "?";
+    row[model_Columns_clusterings.m_col_clustering] = &C;
   }
 
-  if(clusterings.size()){
+  if(distinct_clusterings.total()){
     // enable consensus saving
     clusterings_save1->set_sensitive(true);
     clusterings_save_as1->set_sensitive(true);
@@ -192,10 +283,11 @@ void gcclust_window::update_tvClusterings(){
 
   // if the clusterings changed, then the consensus has to be recalculated
   consensus = clustering<string>();
+  label_consensus = label_clustering();
   update_tvConsensus();
 
   lblClusteringsFrame->set_label("input Clusterings (average distance: ?)");
-  Glib::signal_idle().connect(sigc::mem_fun(*this, &gcclust_window::calc_avg_dist_when_idle) );
+  start_distances();
 }
 
 void gcclust_window::update_tvConsensus(){
@@ -224,12 +316,13 @@ void gcclust_window::update_tvConsensus(){
   }
 
 
-  // if there are too many clusterings or too many elements, this computation takes
-  // way too much time
-  if(clusterings.size() && (clusterings.size()<200) && (clusterings.begin()->size()<200)){
+  if(distinct_clusterings.total() && !label_consensus.empty()){
+    const uint dist = get_distance(label_consensus, distinct_clusterings);
     s.str(std::string());
-    s.precision(4);
-    s << "consensus Clusterings (cumulative distance: " << get_distance(consensus,clusterings) << ")";
+    s << dist;
+    row[model_Columns_clusterings.m_col_distance] = s.str();
+    s.str(std::string());
+    s << "consensus Clusterings (cumulative distance: " << dist << ")";
     lblConsensusFrame->set_label(s.str());
   } else lblConsensusFrame->set_label("consensus Clustering");
 }
@@ -237,6 +330,30 @@ void gcclust_window::update_tvConsensus(){
 // the user pressed the 'compute consensus' button
 void gcclust_window::on_compute_consensus1_activate()
 {
+  // the best input clustering needs neither preprocessing nor search
+  if(best_input1->get_active()){
+    lblProgress->set_label("best input clustering:");
+
+    comp_done_con.disconnect();
+    comp_done_con = signal_computation_done.connect(
+        sigc::mem_fun(*this, &gcclust_window::medoid_complete));
+
+    if(medoid_thread) delete medoid_thread;
+    if(searchtree_thread) delete searchtree_thread;
+    searchtree_thread = NULL;
+    medoid_thread = new medoid_cclust_thread<label_clustering>(&distinct_clusterings,
+        &label_consensus, parallel_search1->get_active() ? 0 : 1,
+        &cancel_computation, &progress_pc, &medoid_cost, &medoid_lower_bound,
+        &signal_computation_done);
+
+    cancel_computation = false;
+    cancel1->set_sensitive(true);
+    start_time = clock();
+    timer_thread.start();
+    medoid_thread->start();
+    return;
+  }
+
   lblProgress->set_label("preprocess:");
 
   uint preprocessing = 0;
@@ -249,9 +366,13 @@ void gcclust_window::on_compute_consensus1_activate()
   comp_done_con = signal_computation_done.connect(
       sigc::mem_fun(*this, &gcclust_window::preprocess_complete));
 
+  // continue from the current consensus (if any)
+  label_consensus = to_label_clustering(consensus, elements);
+
   if(preprocess_thread) delete preprocess_thread;
-  preprocess_thread = new preprocess_cclust_thread<std::string>(&clusterings, &consensus,
-      preprocessing, &cancel_computation, &progress_pc, &signal_computation_done);
+  preprocess_thread = new preprocess_cclust_thread<label_clustering>(&distinct_clusterings,
+      &coassoc, &label_consensus, preprocessing, &cancel_computation, &progress_pc,
+      &signal_computation_done);
 
   cancel_computation = false;
   cancel1->set_sensitive(true);
@@ -273,16 +394,51 @@ void gcclust_window::preprocess_complete(){
   cancel1->set_sensitive(false);
   cancel_computation = false;
 
-  // if the 'brute force' option is selected, start the searchtree_thread
-  if(brute_force_search1->get_active()){
-    lblProgress->set_label("brute force:");
+  // if the 'heuristic search' option is selected, start the heuristic_thread,
+  // which reports the cost of the best clustering found so far
+  if(heuristic_search1->get_active()){
+    heuristic_running = true;
 
 	  comp_done_con.disconnect();
 	  comp_done_con = signal_computation_done.connect(
 	      sigc::mem_fun(*this, &gcclust_window::searchtree_complete));
 
+	  if(heuristic_thread) delete heuristic_thread;
+	  // there are no reduction rules to report
 	  if(searchtree_thread) delete searchtree_thread;
-	  searchtree_thread = new searchtree_cclust_thread<std::string>(&clusterings, &consensus,
+	  searchtree_thread = NULL;
+	  heuristic_thread = new heuristic_cclust_thread<label_clustering>(&coassoc,
+	      &label_consensus,
+	      local_search1->get_active() ? HEURISTIC_LOCAL_SEARCH : HEURISTIC_PIVOT,
+	      HEURISTIC_RESTARTS,
+	      parallel_search1->get_active() ? 0 : 1,
+	      &cancel_computation, &signal_computation_done);
+
+	  cancel1->set_sensitive(true);
+	  heuristic_thread->start();
+  } else if(brute_force_search1->get_active()){
+    // if the 'brute force' option is selected, start the searchtree_thread
+    // the average parameterized search is budgeted by the average distance
+    search_method method = branch_and_bound1->get_active() ? SEARCH_BRANCH_AND_BOUND : SEARCH_BRUTE_FORCE;
+    if(average_parameterized1->get_active()){
+      method = SEARCH_AVERAGE_PARAMETERIZED;
+      vector<element_id> all_elements(coassoc.num_elements());
+      for(element_id x = 0; x < all_elements.size(); x++) all_elements[x] = x;
+      std::stringstream s;
+      s.precision(6);
+      s << "average parameterized (d = " << get_avg_distance(coassoc, all_elements) << "):";
+      lblProgress->set_label(s.str());
+    } else lblProgress->set_label(branch_and_bound1->get_active() ? "branch and bound:" : "brute force:");
+
+	  comp_done_con.disconnect();
+	  comp_done_con = signal_computation_done.connect(
+	      sigc::mem_fun(*this, &gcclust_window::searchtree_complete));
+
+	  if(searchtree_thread) delete searchtree_thread;
+	  searchtree_thread = new searchtree_cclust_thread<label_clustering>(&coassoc,
+	      &label_consensus,
+	      method,
+	      parallel_search1->get_active() ? 0 : 1,
 	      &cancel_computation, &progress_pc, &signal_computation_done);
 
 	  cancel1->set_sensitive(true);
@@ -296,7 +452,8 @@ void gcclust_window::preprocess_complete(){
     clock_t stop_time;
     if(measure_time) stop_time = clock();
 
-    // update the consensus view
+    // map the result back to the element names and update the consensus view
+    consensus = to_clustering(label_consensus, elements);
     update_tvConsensus();
 
     // show a dialog informing the user about the computation time
@@ -319,6 +476,7 @@ void gcclust_window::searchtree_complete(){
   DEBUG("computation complete" << std::endl);
   cancel1->set_sensitive(false);
   cancel_computation = false;
+  heuristic_running = false;
   lblProgress->set_label("done");
 
   // wait till the timer thread finishes up
@@ -329,9 +487,17 @@ void gcclust_window::searchtree_complete(){
   clock_t stop_time;
   if(measure_time) stop_time = clock();
 
-  // update the consensus view
+  // map the result back to the element names and update the consensus view
+  consensus = to_clustering(label_consensus, elements);
   update_tvConsensus();
 
+  if(searchtree_thread){
+    const std::vector<reduction_rule> rules = get_default_reduction_rules();
+    const std::vector<uint>& hits = searchtree_thread->get_rule_hits();
+    for(uint r = 0; r < hits.size(); r++)
+      DEBUG("reduction rule " << rules[r].name << ": " << hits[r] << " hits" << std::endl);
+  }
+
   // show a dialog informing the user about the computation time
   if(measure_time){
       std::stringstream s;
@@ -344,19 +510,38 @@ void gcclust_window::searchtree_complete(){
   }
 }
 
+// the best input clustering is found, the medoid thread is returning to this
+// function as a callback
+void gcclust_window::medoid_complete(){
+  searchtree_complete();
+  if(!label_consensus.empty()){
+    std::stringstream s;
+    s << "best input (cost " << medoid_cost << ", optimum >= " << medoid_lower_bound << ")";
+    lblProgress->set_label(s.str());
+  }
+}
+
 // this function is called every 100us by the timer thread
 void gcclust_window::update_percent(){
   stringstream s;
   s.precision(4);
-  s << 100*progress_pc << "\%";
+  const double pc = heuristic_running ? heuristic_thread->get_progress() : progress_pc;
+  s << 100*pc << "\%";
   pgbProgress->set_text(s.str());
-  pgbProgress->set_fraction(progress_pc);
+  pgbProgress->set_fraction(pc);
+  const uint64_t heuristic_cost = heuristic_running ? heuristic_thread->get_best_cost() : 0;
+  if(heuristic_cost){
+    s.str(std::string());
+    s << "heuristic (best: " << heuristic_cost << "):";
+    lblProgress->set_label(s.str());
+  }
 }
 
 // callback function for the search tree algorithm to signal that its
 // computation started
 void gcclust_window::brute_start(const clustering<std::string> &cons){
   consensus = cons;
+  label_consensus = to_label_clustering(consensus, elements);
   update_tvConsensus();
   lblProgress->set_label("search tree:");
 }
@@ -414,6 +599,7 @@ void gcclust_window::on_consensus_save_as1_activate()
 void gcclust_window::on_edit1_activate()
 {
   edit1->set_sensitive(false);
+  build_clusterings();
   EditClusterings = new class edit_clusterings_window(&clusterings);
   // add callback to when the edit window is closed
   EditClusterings->window->signal_hide().connect(sigc::mem_fun(*this, &gcclust_window::on_edit_complete), false);
@@ -431,10 +617,28 @@ void gcclust_window::on_open1_activate()
   clusterings_filename = select_a_file("please select a file to load clusterings from");
 
   if(clusterings_filename.size()){
-    clusterings = read_clusterings_from_file<string>(clusterings_filename);
+    // read the dense representation directly, the clusterings by name are
+    // only built for editing
+    clusterings.clear();
+    label_clusterings.clear();
+    stop_distances();
+    delete binary_input;
+    // a file in the binary format stays mapped, only its distinct clusterings are copied
+    binary_input = new binary_clusterings(clusterings_filename);
+    if(binary_input->good() && get_binary_elements(*binary_input, elements))
+      distinct_clusterings = get_weighted_clusterings(*binary_input);
+    else {
+      delete binary_input;
+      binary_input = NULL;
+      if(!read_label_clusterings_from_file(clusterings_filename, elements, label_clusterings)){
+        elements.clear();
+        label_clusterings.clear();
+      }
+      distinct_clusterings = weighted_clusterings(label_clusterings);
+    }
 
     // load the new clusterings into the treeview
-    update_tvClusterings();
+    update_tvClusterings(false);
   }
 }
 
@@ -460,10 +664,33 @@ void gcclust_window::on_generate_randomly1_activate()
   update_tvClusterings();
 }
 
+// each input clustering by name is a copy of its distinct clustering
+void gcclust_window::build_clusterings(){
+  if(clusterings.size() == distinct_clusterings.total()) return;
+  clusterings.clear();
+  clusterings.reserve(distinct_clusterings.total());
+  for(uint i = 0; i < distinct_clusterings.total(); i++)
+    clusterings.push_back(shown_clusterings[distinct_clusterings.index_of[i]]);
+}
+
+void gcclust_window::detach_binary_input(){
+  if(!binary_input) return;
+  label_clusterings.resize(binary_input->num_clusterings());
+  for(uint i = 0; i < label_clusterings.size(); i++) binary_input->get_clustering(i, label_clusterings[i]);
+  delete binary_input;
+  binary_input = NULL;
+}
+
 void gcclust_window::on_clusterings_save1_activate()
 {
   if(clusterings_filename.size()){
-    write_clusterings_to_file<std::string>(clusterings_filename, clusterings);
+    // the file may be the one the clusterings are mapped from, afterwards
+    // label_clusterings holds the input in any case
+    detach_binary_input();
+    // files with the extension of the binary format are saved in it (also compressed ones)
+    if(has_extension(strip_compression_extension(clusterings_filename), BINARY_CLUSTERINGS_EXTENSION))
+      write_binary_clusterings_to_file(clusterings_filename, elements, label_clusterings);
+    else write_label_clusterings_to_file(clusterings_filename, elements, label_clusterings);
   } else on_clusterings_save_as1_activate();
 }
 
@@ -12,22 +12,50 @@ class gcclust_window
 {
   // random stuff
   std::string clusterings_filename;
+  // the clusterings by name, if they were read in the dense representation,
+  // they are only built for editing (see build_clusterings)
   std::vector<clustering<std::string> > clusterings;
 
   std::string consensus_filename;
   clustering<std::string> consensus;
 
+  // the dense representation of clusterings and consensus that the
+  // computation threads work on, rebuilt whenever the clusterings change
+  element_dictionary<std::string> elements;
+  // a file in the binary format is used in place (label_clusterings stays
+  // empty), otherwise the clusterings are translated into label_clusterings
+  binary_clusterings* binary_input;
+  std::vector<label_clustering> label_clusterings;
+  // the distinct clusterings, each is listed once with its multiplicity
+  weighted_clusterings distinct_clusterings;
+  // the distinct clusterings by name, shown in tvClusterings
+  std::vector<clustering<std::string> > shown_clusterings;
+  label_clustering label_consensus;
+  // co-clustering counts of the clusterings, computed by the preprocess_thread
+  coassociation_matrix coassoc;
+
   // Edit Clusterings window
   edit_clusterings_window* EditClusterings;
 
   // a thread to solve the instances in the background
-  preprocess_cclust_thread<std::string> *preprocess_thread;
-  searchtree_cclust_thread<std::string> *searchtree_thread;
+  preprocess_cclust_thread<label_clustering> *preprocess_thread;
+  searchtree_cclust_thread<label_clustering> *searchtree_thread;
+  heuristic_cclust_thread<label_clustering> *heuristic_thread;
+  // the progress and the best cost are read from heuristic_thread while it runs
+  bool heuristic_running;
+  medoid_cclust_thread<label_clustering> *medoid_thread;
+  // the cost of the best input clustering and the lower bound it implies
+  uint64_t medoid_cost;
+  uint64_t medoid_lower_bound;
+  // a thread to compute the distances between the input clusterings
+  distances_cclust_thread *distances_thread;
 
   // dispatcher for showing progress and changing labels and treeviews
   Glib::Dispatcher signal_progress_pc;
   Glib::Dispatcher signal_computation_done;
   sigc::connection comp_done_con;
+  Glib::Dispatcher signal_distances_progress;
+  Glib::Dispatcher signal_distances_done;
 
   double progress_pc;
   // a thread to update the progress bar from progress_pc every 100us
@@ -35,10 +63,11 @@ class gcclust_window
 
   // treeview stuff
   class ClusteringColumns : public Gtk::TreeModel::ColumnRecord{
-    // TODO: add a "distance" column
   	public:
-  	ClusteringColumns(){ add(m_col_text); add(m_col_clustering);}
+  	ClusteringColumns(){ add(m_col_text); add(m_col_distance); add(m_col_clustering);}
   	Gtk::TreeModelColumn<std::string> m_col_text;
+    // the sum of distances to all input clusterings
+  	Gtk::TreeModelColumn<std::string> m_col_distance;
     // this is hidden data, because it is not being added as a view column
   	Gtk::TreeModelColumn<const clustering<std::string>* > m_col_clustering;
   };
@@ -46,9 +75,14 @@ class gcclust_window
   Glib::RefPtr<Gtk::ListStore> pClusteringsList;
   Glib::RefPtr<Gtk::ListStore> pConsensusList;
 
-  // update the treeview using the clusterings vector
-  void update_tvClusterings();
+  // update the treeview using the clusterings vector, if update_labels is
+  // unset, the dense representation is already up to date
+  void update_tvClusterings(const bool update_labels=true);
   void update_tvConsensus();
+  // build the clusterings by name from the distinct clusterings
+  void build_clusterings();
+  // copy the clusterings out of the binary file (before it is overwritten)
+  void detach_binary_input();
   std::string select_a_file(const std::string caption,
       const Gtk::FileChooserAction action = Gtk::FILE_CHOOSER_ACTION_OPEN);
   void on_edit_complete();
@@ -61,8 +95,11 @@ class gcclust_window
   void update_percent();
   void preprocess_complete();
   void searchtree_complete();
+  void medoid_complete();
   void brute_start(const clustering<std::string> &cons);
-  bool calc_avg_dist_when_idle();
+  void start_distances();
+  void stop_distances();
+  void update_distances();
 
 
   // ========== window elements we use ==================
@@ -91,6 +128,12 @@ class gcclust_window
     Gtk::ImageMenuItem* consensus_save1;
     Gtk::ImageMenuItem* consensus_save_as1;
     Gtk::CheckMenuItem* brute_force_search1;
+    Gtk::CheckMenuItem* branch_and_bound1;
+    Gtk::CheckMenuItem* average_parameterized1;
+    Gtk::CheckMenuItem* parallel_search1;
+    Gtk::CheckMenuItem* heuristic_search1;
+    Gtk::CheckMenuItem* local_search1;
+    Gtk::CheckMenuItem* best_input1;
     Gtk::ImageMenuItem* compute_consensus1;
 
   private: